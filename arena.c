@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "ui.h"
+
+struct arenachunk {
+	struct arenachunk	*next;
+};
+
+/* Every allocation is aligned as malloc(3) would do on amd64 */
+#define ARENA_ALIGN	16
+#define ARENA_ROUND(x)	(((x) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_DATA(c)	((unsigned char *)(c) + ARENA_ROUND(sizeof(*(c))))
+
+void
+arena_init(struct arena *a)
+{
+	(void)memset(a, 0, sizeof(*a));
+}
+
+/*
+ * Give size bytes of zeroed memory, or NULL. Requests too large for a
+ * chunk get one of their own, placed behind the current one so its free
+ * space is not lost.
+ */
+void *
+arena_alloc(struct arena *a, size_t size)
+{
+	struct arenachunk	*chunk;
+	size_t			 chunksz;
+	void			*p;
+
+	size = ARENA_ROUND(size);
+	if (0 == size)
+		size = ARENA_ALIGN;
+	if (NULL == a->chunks || a->size - a->used < size) {
+		chunksz = size > ARENA_CHUNKSZ ? size : ARENA_CHUNKSZ;
+		chunk = calloc(1, ARENA_ROUND(sizeof(*chunk)) + chunksz);
+		if (NULL == chunk)
+			return(NULL);
+		a->nchunks += 1;
+		a->reserved += chunksz;
+		if (chunksz == size && NULL != a->chunks) {
+			chunk->next = a->chunks->next;
+			a->chunks->next = chunk;
+			p = ARENA_DATA(chunk);
+			goto done;
+		}
+		chunk->next = a->chunks;
+		a->chunks = chunk;
+		a->used = 0;
+		a->size = chunksz;
+	}
+	p = ARENA_DATA(a->chunks) + a->used;
+	a->used += size;
+done:
+	a->allocs += 1;
+	a->bytes += size;
+	return(p);
+}
+
+void *
+arena_calloc(struct arena *a, size_t nmemb, size_t size)
+{
+	if (0 != size && nmemb > SIZE_MAX / size)
+		return(NULL);
+	return(arena_alloc(a, nmemb * size));
+}
+
+void
+arena_release(struct arena *a)
+{
+	struct arenachunk *chunk, *next;
+
+	for (chunk = a->chunks; NULL != chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	arena_init(a);
+}
+
+void
+arena_log_stats(struct arena *a, const char *name)
+{
+	log_debug("Arena %s: %llu allocations, %llu bytes used, %llu chunks "
+	    "holding %llu bytes\n", name, (unsigned long long)a->allocs,
+	    (unsigned long long)a->bytes, (unsigned long long)a->nchunks,
+	    (unsigned long long)a->reserved);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARENA_H__
+#define ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of the chunks the arena carves its allocations from */
+#define ARENA_CHUNKSZ	(256 * 1024)
+
+struct arenachunk;
+
+/*
+ * Region allocator: memory is only ever given back all at once, when the
+ * arena is released.
+ */
+struct arena {
+	struct arenachunk	*chunks;
+	size_t			 used;
+	size_t			 size;
+	/* Statistics */
+	uint64_t		 allocs;
+	uint64_t		 bytes;
+	uint64_t		 nchunks;
+	uint64_t		 reserved;
+};
+
+void	 arena_init(struct arena *);
+void	*arena_alloc(struct arena *, size_t);
+void	*arena_calloc(struct arena *, size_t, size_t);
+void	 arena_release(struct arena *);
+void	 arena_log_stats(struct arena *, const char *);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "level.h"
+
+void
+bitboard_clear(struct bitboard *b)
+{
+	(void)memset(b, 0, sizeof(*b));
+}
+
+/*
+ * Add to src each of its cells moved by one column, in both directions,
+ * and store it in dst. Bits never leave the level.
+ */
+static void
+bitboard_row_spread(uint64_t *dst, const uint64_t *src)
+{
+	uint64_t left0, left1, right0, right1;
+
+	/* Toward the higher columns */
+	left0 = src[0] << 1;
+	left1 = (src[1] << 1 | src[0] >> 63) & BITBOARD_LAST;
+	/* Toward the lower columns */
+	right0 = src[0] >> 1 | src[1] << 63;
+	right1 = src[1] >> 1;
+	dst[0] = src[0] | left0 | right0;
+	dst[1] = src[1] | left1 | right1;
+}
+
+/*
+ * Grow every cell of src to its eight neighbours and store it in dst, which
+ * may be the same as src.
+ */
+void
+bitboard_dilate(struct bitboard *dst, const struct bitboard *src)
+{
+	uint64_t spread[MAXROWS][BITBOARD_WORDS];
+
+	for (int y = 0; y < MAXROWS; y++)
+		bitboard_row_spread(spread[y], src->row[y]);
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int w = 0; w < BITBOARD_WORDS; w++) {
+			uint64_t row = spread[y][w];
+
+			if (y > 0)
+				row |= spread[y - 1][w];
+			if (y < MAXROWS - 1)
+				row |= spread[y + 1][w];
+			dst->row[y][w] = row;
+		}
+	}
+}
+
+/*
+ * Flood fill reach within passable, a whole bitboard at a time, until it
+ * stops growing or until (y, x) is reached. Return true if it was.
+ * Use (-1, -1) to fill everything that can be reached.
+ */
+bool
+bitboard_flood(struct bitboard *reach, const struct bitboard *passable,
+    int y, int x)
+{
+	struct bitboard next;
+	bool grown;
+
+	do {
+		if (y >= 0 && BITBOARD_TEST(reach, y, x))
+			return(true);
+		bitboard_dilate(&next, reach);
+		grown = false;
+		for (int i = 0; i < MAXROWS; i++) {
+			for (int w = 0; w < BITBOARD_WORDS; w++) {
+				uint64_t row;
+
+				row = next.row[i][w] & passable->row[i][w];
+				row |= reach->row[i][w];
+				if (row != reach->row[i][w])
+					grown = true;
+				reach->row[i][w] = row;
+			}
+		}
+	} while (grown);
+	return(y >= 0 && BITBOARD_TEST(reach, y, x));
+}
+
+int
+bitboard_count(const struct bitboard *b)
+{
+	int count = 0;
+
+	for (int y = 0; y < MAXROWS; y++)
+		for (int w = 0; w < BITBOARD_WORDS; w++)
+			count += __builtin_popcountll(b->row[y][w]);
+	return(count);
+}
+
+/*
+ * Count the cells set in both a and b.
+ */
+int
+bitboard_count_both(const struct bitboard *a, const struct bitboard *b)
+{
+	int count = 0;
+
+	for (int y = 0; y < MAXROWS; y++)
+		for (int w = 0; w < BITBOARD_WORDS; w++)
+			count += __builtin_popcountll(a->row[y][w] &
+			    b->row[y][w]);
+	return(count);
+}
@@ -17,6 +17,7 @@
 #include <sys/types.h>
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
@@ -25,73 +26,293 @@
 #include "level.h"
 #include "rng.h"
 
-/* Cave specific options */
-static int cave_step = 3; /* Number of calls to cave_reduce_noise */
-static int cave_ratio = 40; /* Percentage of wall generated at initialization */
+/* Default cave options, the ones of the original generator */
+const struct cave_params cave_defaults = {
+	3,	/* Number of calls to cave_reduce_noise */
+	40,	/* Percentage of wall generated at initialization */
+	5,	/* Walls around an empty cell turning it into a wall */
+	4,	/* Walls around a wall needed to keep it */
+};
 
 /* Cave functions */
-static enum tile_type rand_pick(unsigned int);
-static void cave_init(struct level *);
-static void cave_reduce_noise(struct level *, struct level *);
+static void cave_init(struct bitboard *, const struct cave_params *,
+    struct rng *);
+static void cave_reduce_noise(struct bitboard *, const struct bitboard *,
+    const struct cave_params *);
 
-/* Cave level generation with the cellular automata algorithm */
+/*
+ * Cave level generation with the cellular automata algorithm.
+ * The generation alternates between two wall bitboards and the level is
+ * written only once at the end. Use the default options if p is NULL.
+ */
 void
-cave_gen(struct level *l) {
-	int s;
-	struct level tmp;
-
-	cave_init(l);
-	(void)memcpy(&tmp, l, sizeof(*l));
-	for (s = 0; s < cave_step; ++s) {
-		cave_reduce_noise(l, &tmp);
-		(void)memcpy(l, &tmp, sizeof(tmp));
+cave_gen(struct level *l, const struct cave_params *p, struct rng *r) {
+	int s, y, x;
+	struct bitboard buf[2];
+	struct bitboard *cur, *next, *swap;
+
+	if (NULL == p)
+		p = &cave_defaults;
+	cur = &buf[0];
+	next = &buf[1];
+	cave_init(cur, p, r);
+	for (s = 0; s < p->steps; ++s) {
+		cave_reduce_noise(next, cur, p);
+		swap = cur;
+		cur = next;
+		next = swap;
 	}
+	l->type = L_CAVE;
+	for (y = 0; y < MAXROWS; ++y)
+		for (x = 0; x < MAXCOLS; ++x)
+			level_set_type(l, y, x,
+			    BITBOARD_TEST(cur, y, x) ? T_WALL : T_EMPTY);
+	level_label(l);
+}
+
+/*
+ * The smoothing rule is computed on the wall bitboard for a whole row at a
+ * time. The 3x3 sum of walls around each cell is built with bit-sliced
+ * adders: every bit of a word is a different cell and the bits of the sum
+ * are spread over several words.
+ */
+#if defined(__SSE2__) && !defined(CAVE_NO_SIMD)
+#include <emmintrin.h>
+
+/* With 80 columns a row fits exactly in a SSE2 register */
+typedef __m128i cave_row;
+
+static cave_row
+row_load(const uint64_t *r)
+{
+	return(_mm_loadu_si128((const __m128i *)r));
 }
 
 static void
-cave_reduce_noise(struct level *l, struct level *tmp) {
-	int x, y;
-	int ix, iy;
-
-	for (y = 1; y < MAXROWS - 1; ++y)
-		for (x = 1; x < MAXCOLS - 1; ++x) {
-			unsigned int nwall = 0;
-			for (iy = -1; iy <= 1; ++iy)
-				for (ix = -1; ix <= 1; ++ix)
-					if (l->tile[y + iy][x + ix].type
-					    == T_WALL)
-						++nwall;
-			if (nwall >= 5)
-				tmp->tile[y][x].type = T_WALL;
-			else
-				tmp->tile[y][x].type = T_EMPTY;
+row_store(uint64_t *r, cave_row v)
+{
+	_mm_storeu_si128((__m128i *)r, v);
+}
+
+#define ROW_AND(a, b)	_mm_and_si128((a), (b))
+#define ROW_OR(a, b)	_mm_or_si128((a), (b))
+#define ROW_XOR(a, b)	_mm_xor_si128((a), (b))
+/* Cells of b which are not in a */
+#define ROW_ANDNOT(a, b)	_mm_andnot_si128((a), (b))
+
+/* Move every cell toward the higher columns */
+static cave_row
+row_shl(cave_row v)
+{
+	return(_mm_or_si128(_mm_slli_epi64(v, 1),
+	    _mm_srli_epi64(_mm_slli_si128(v, 8), 63)));
+}
+
+/* Move every cell toward the lower columns */
+static cave_row
+row_shr(cave_row v)
+{
+	return(_mm_or_si128(_mm_srli_epi64(v, 1),
+	    _mm_slli_epi64(_mm_srli_si128(v, 8), 63)));
+}
+#else
+typedef struct {
+	uint64_t w[BITBOARD_WORDS];
+} cave_row;
+
+static cave_row
+row_load(const uint64_t *r)
+{
+	cave_row v;
+
+	v.w[0] = r[0];
+	v.w[1] = r[1];
+	return(v);
+}
+
+static void
+row_store(uint64_t *r, cave_row v)
+{
+	r[0] = v.w[0];
+	r[1] = v.w[1];
+}
+
+static cave_row
+row_and(cave_row a, cave_row b)
+{
+	a.w[0] &= b.w[0];
+	a.w[1] &= b.w[1];
+	return(a);
+}
+
+static cave_row
+row_or(cave_row a, cave_row b)
+{
+	a.w[0] |= b.w[0];
+	a.w[1] |= b.w[1];
+	return(a);
+}
+
+static cave_row
+row_xor(cave_row a, cave_row b)
+{
+	a.w[0] ^= b.w[0];
+	a.w[1] ^= b.w[1];
+	return(a);
+}
+
+static cave_row
+row_andnot(cave_row a, cave_row b)
+{
+	b.w[0] &= ~a.w[0];
+	b.w[1] &= ~a.w[1];
+	return(b);
+}
+
+#define ROW_AND(a, b)	row_and((a), (b))
+#define ROW_OR(a, b)	row_or((a), (b))
+#define ROW_XOR(a, b)	row_xor((a), (b))
+#define ROW_ANDNOT(a, b)	row_andnot((a), (b))
+
+static cave_row
+row_shl(cave_row v)
+{
+	cave_row r;
+
+	r.w[0] = v.w[0] << 1;
+	r.w[1] = v.w[1] << 1 | v.w[0] >> 63;
+	return(r);
+}
+
+static cave_row
+row_shr(cave_row v)
+{
+	cave_row r;
+
+	r.w[0] = v.w[0] >> 1 | v.w[1] << 63;
+	r.w[1] = v.w[1] >> 1;
+	return(r);
+}
+#endif
+
+/* Sum of a cell and its two horizontal neighbours, as a 2 bits number */
+static void
+row_sum3(cave_row v, cave_row *s0, cave_row *s1)
+{
+	cave_row a, c, ac;
+
+	a = row_shl(v);
+	c = row_shr(v);
+	ac = ROW_XOR(a, c);
+	*s0 = ROW_XOR(ac, v);
+	*s1 = ROW_OR(ROW_AND(a, c), ROW_AND(v, ac));
+}
+
+/*
+ * Cells whose sum, given as four bit-sliced words, is at least k.
+ * The bits of k are compared from the highest one while the cells remain
+ * equal to its prefix.
+ */
+static cave_row
+row_at_least(const cave_row *bit, int k, cave_row ones)
+{
+	cave_row gt, eq;
+
+	if (k <= 0)
+		return(ones);
+	if (k > 15)
+		return(ROW_XOR(ones, ones));
+	gt = ROW_XOR(ones, ones);
+	eq = ones;
+	for (int i = 3; i >= 0; i--) {
+		if (k & (1 << i)) {
+			eq = ROW_AND(eq, bit[i]);
+		} else {
+			gt = ROW_OR(gt, ROW_AND(eq, bit[i]));
+			eq = ROW_ANDNOT(bit[i], eq);
 		}
+	}
+	return(ROW_OR(gt, eq));
+}
+
+static void
+cave_reduce_noise(struct bitboard *dst, const struct bitboard *src,
+    const struct cave_params *p)
+{
+	cave_row s0[MAXROWS], s1[MAXROWS];
+	cave_row inner, ones;
+	uint64_t mask[BITBOARD_WORDS];
+
+	/* Every column but the first and the last one */
+	mask[0] = ~UINT64_C(1);
+	mask[1] = BITBOARD_LAST >> 1;
+	inner = row_load(mask);
+	mask[0] = ~UINT64_C(0);
+	mask[1] = ~UINT64_C(0);
+	ones = row_load(mask);
+	for (int y = 0; y < MAXROWS; y++)
+		row_sum3(row_load(src->row[y]), &s0[y], &s1[y]);
+	row_store(dst->row[0], row_load(src->row[0]));
+	row_store(dst->row[MAXROWS - 1], row_load(src->row[MAXROWS - 1]));
+	for (int y = 1; y < MAXROWS - 1; y++) {
+		cave_row a0, b0, c0, a1, b1, c1;
+		cave_row bit[4], carry0, t, carry1, carry2;
+		cave_row self, wall, border;
+
+		a0 = s0[y - 1];
+		b0 = s0[y];
+		c0 = s0[y + 1];
+		a1 = s1[y - 1];
+		b1 = s1[y];
+		c1 = s1[y + 1];
+		/* Full adder on the units */
+		t = ROW_XOR(a0, b0);
+		bit[0] = ROW_XOR(t, c0);
+		carry0 = ROW_OR(ROW_AND(a0, b0), ROW_AND(c0, t));
+		/* Full adder on the twos, then add the carry of the units */
+		t = ROW_XOR(a1, b1);
+		bit[1] = ROW_XOR(t, c1);
+		carry1 = ROW_OR(ROW_AND(a1, b1), ROW_AND(c1, t));
+		carry2 = ROW_AND(bit[1], carry0);
+		bit[1] = ROW_XOR(bit[1], carry0);
+		/* The fours and the eights */
+		bit[2] = ROW_XOR(carry1, carry2);
+		bit[3] = ROW_AND(carry1, carry2);
+		/*
+		 * The sum includes the cell itself, so a wall needs one more
+		 * to survive than the number of its neighbours.
+		 */
+		self = row_load(src->row[y]);
+		wall = ROW_OR(
+		    ROW_AND(self, row_at_least(bit, p->survival + 1, ones)),
+		    ROW_ANDNOT(self, row_at_least(bit, p->birth, ones)));
+		/* Keep the border of the level as it is */
+		border = ROW_ANDNOT(inner, self);
+		row_store(dst->row[y], ROW_OR(ROW_AND(wall, inner), border));
+	}
 }
 
 static void
-cave_init(struct level *l) {
+cave_init(struct bitboard *b, const struct cave_params *p, struct rng *r) {
 	int x, y;
 
-	l->type = L_CAVE;
-	/* randomly fill the map */
-	for (y = 1; y < MAXROWS - 1; ++y)
-		for (x = 1; x < MAXCOLS - 1; ++x)
-			l->tile[y][x].type = rand_pick(cave_ratio);
+	bitboard_clear(b);
+	/* randomly fill the map, skipping the first column */
+	for (y = 1; y < MAXROWS - 1; ++y) {
+		uint64_t row[BITBOARD_WORDS];
+
+		rng_fill_bits_r(r, row, MAXCOLS - 2, p->ratio);
+		b->row[y][0] = row[0] << 1;
+		b->row[y][1] = row[1] << 1 | row[0] >> 63;
+	}
 
 	for (y = 0; y < MAXROWS; ++y) {
-		l->tile[y][0].type = T_WALL;
-		l->tile[y][MAXCOLS - 1].type = T_WALL;
+		BITBOARD_SET(b, y, 0);
+		BITBOARD_SET(b, y, MAXCOLS - 1);
 	}
 
 	for (x = 0; x < MAXCOLS; ++x) {
-		l->tile[0][x].type = T_WALL;
-		l->tile[MAXROWS - 1][x].type = T_WALL;
+		BITBOARD_SET(b, 0, x);
+		BITBOARD_SET(b, MAXROWS - 1, x);
 	}
 }
-
-static enum tile_type
-rand_pick(unsigned int ratio) {
-	unsigned int x = rng_rand_uniform(100);
-	return (x < ratio) ? T_WALL : T_EMPTY;
-}
-
@@ -15,208 +15,389 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "arena.h"
 #include "level.h"
 #include "creature.h"
+#include "pathfind.h"
+#include "distmap.h"
 #include "rng.h"
 
-static void human_init(struct creature *);
-static void goblin_init(struct creature *);
+/* Distance under which goblins notice the player and chase it */
+#define GOBLIN_SIGHT 10
+
+/* Number of slots of a table on its first growth */
+#define CREATURES_MINCAPACITY 64
+
+/* Directions of a random move, the choice being drawn from the stream */
+static const struct {
+	int	 row;
+	int	 col;
+} creature_dirs[8] = {
+	{ 0, -1 },	/* left */
+	{ 1, 0 },	/* down */
+	{ -1, 0 },	/* up */
+	{ 0, 1 },	/* right */
+	{ -1, -1 },	/* upleft */
+	{ 1, -1 },	/* downleft */
+	{ -1, 1 },	/* upright */
+	{ 1, 1 },	/* downright */
+};
+
+static const int16_t race_speed[R__MAX] = {
+	5,	/* R_HUMAN */
+	7,	/* R_GOBLIN */
+};
 
 void
-creature_init(struct creature *c, enum race race)
-{
-	c->race = race;
-	c->actionpoints = 0;
-	switch (race) {
-	case R_HUMAN:
-		human_init(c);
-		break;
-	case R_GOBLIN:
-		goblin_init(c);
-		break;
-	case R__MAX:
-	default:
-		return; /* XXX error in some way */
+creatures_init(struct creatures *t, struct arena *a)
+{
+	(void)memset(t, 0, sizeof(*t));
+	t->arena = a;
+}
+
+#define CREATURES_GROW(t, field, newcap) do {				\
+	void *p = arena_calloc((t)->arena, (newcap), sizeof(*(t)->field));\
+	if (NULL == p)							\
+		return(-1);						\
+	if (0 != (t)->size)						\
+		(void)memcpy(p, (t)->field,				\
+		    (t)->size * sizeof(*(t)->field));			\
+	(t)->field = p;							\
+} while (0)
+
+/*
+ * Double the capacity of the table. The previous arrays stay in the arena
+ * until it is released, which costs at most as much as the table itself.
+ */
+static int
+creatures_grow(struct creatures *t)
+{
+	uint32_t newcap;
+
+	if (0 == t->capacity)
+		newcap = CREATURES_MINCAPACITY;
+	else
+		newcap = t->capacity * 2;
+	if (newcap > CREATURE_MAXINDEX + 1)
+		newcap = CREATURE_MAXINDEX + 1;
+	if (newcap == t->capacity)
+		return(-1);
+	CREATURES_GROW(t, x, newcap);
+	CREATURES_GROW(t, y, newcap);
+	CREATURES_GROW(t, speed, newcap);
+	CREATURES_GROW(t, actionpoints, newcap);
+	CREATURES_GROW(t, race, newcap);
+	CREATURES_GROW(t, generation, newcap);
+	CREATURES_GROW(t, depth, newcap);
+	CREATURES_GROW(t, sibling, newcap);
+	CREATURES_GROW(t, next, newcap);
+	CREATURES_GROW(t, rng, newcap);
+	t->capacity = newcap;
+	return(0);
+}
+
+/*
+ * Give the handle of a new creature, not placed on any level yet, or
+ * CREATURE_NONE if the table is full.
+ */
+uint32_t
+creature_spawn(struct creatures *t, enum race race)
+{
+	uint32_t i;
+
+	if (0 != t->freelist) {
+		i = t->freelist - 1;
+		t->freelist = t->next[i];
+	} else {
+		if (t->size == t->capacity && -1 == creatures_grow(t))
+			return(CREATURE_NONE);
+		i = t->size;
+		t->size += 1;
 	}
+	t->generation[i] = (t->generation[i] + 1) & 0xfff;
+	if (0 == t->generation[i])
+		t->generation[i] = 1;
+	t->x[i] = -1;
+	t->y[i] = -1;
+	t->race[i] = race;
+	t->speed[i] = race_speed[race];
+	t->actionpoints[i] = 0;
+	t->depth[i] = -1;
+	t->sibling[i] = 0;
+	t->next[i] = 0;
+	rng_stream_init(&(t->rng[i]), 0, RNG_CREATURE, i);
+	t->count += 1;
+	return(creature_handle(t, i));
+}
+
+/*
+ * Remove a creature from the tiles of its level, if any, and give its slot
+ * back. It must have been taken out of the list of its level and out of
+ * the scheduler first.
+ */
+void
+creature_despawn(struct creatures *t, struct level *l, uint32_t c)
+{
+	uint32_t i = CREATURE_INDEX(c);
+
+	if (! creature_is_alive(t, c))
+		return;
+	if (NULL != l && -1 != t->y[i]
+	    && c == l->tile[t->y[i]][t->x[i]].creature)
+		level_set_creature(l, t->y[i], t->x[i], CREATURE_NONE);
+	t->race[i] = R__MAX;
+	t->next[i] = t->freelist;
+	t->freelist = i + 1;
+	t->count -= 1;
+}
+
+bool
+creature_is_alive(struct creatures *t, uint32_t c)
+{
+	uint32_t i = CREATURE_INDEX(c);
+
+	return(CREATURE_NONE != c && i < t->size && R__MAX != t->race[i]
+	    && t->generation[i] == CREATURE_GENERATION(c));
+}
+
+/*
+ * Give the handle of the creature in the slot i, or CREATURE_NONE if the
+ * slot is free.
+ */
+uint32_t
+creature_handle(struct creatures *t, uint32_t i)
+{
+	if (i >= t->size || R__MAX == t->race[i])
+		return(CREATURE_NONE);
+	return((uint32_t)t->generation[i] << CREATURE_INDEXBITS | i);
 }
 
 void
-creature_place_randomly(struct creature *c, struct level *l)
+creature_place_randomly(struct creatures *t, uint32_t c, struct level *l,
+    struct rng *r)
 {
+	uint32_t i = CREATURE_INDEX(c);
 	int y, x;
 
 	do {
-		y = rng_rand_uniform(MAXROWS);
-		x = rng_rand_uniform(MAXCOLS);
+		y = rng_rand_uniform_r(r, MAXROWS);
+		x = rng_rand_uniform_r(r, MAXCOLS);
 		if (tile_is_empty(&(l->tile[y][x]))) {
-			c->x = x;
-			c->y = y;
-			l->tile[y][x].creature = c;
+			t->x[i] = x;
+			t->y[i] = y;
+			level_set_creature(l, y, x, c);
 			break;
 		}
 	} while (1);
 }
 
+/*
+ * Put the creature on the stairs of the level, or as close as possible if
+ * something already stands there.
+ */
 void
-creature_place_at_stair(struct creature *c, struct level *l, bool up)
+creature_place_at_stair(struct creatures *t, uint32_t c, struct level *l,
+    bool up)
 {
-	int y, x;
+	struct bfs		 b;
+	struct coordinate	 stair, best;
+	uint32_t		 i = CREATURE_INDEX(c);
+	int			 bestdist, dist;
 
-	for (y = 0; y < MAXROWS; ++y)
-		for (x = 0; x < MAXCOLS; ++x)
-			if ((l->tile[y][x].type == T_UPSTAIR && up)
-			    || (l->tile[y][x].type == T_DOWNSTAIR && !up)) {
-				c->x = x;
-				c->y = y;
-				l->tile[y][x].creature = c;
-				return;
+	if (-1 == level_find(l, up ? T_UPSTAIR : T_DOWNSTAIR, &stair))
+		return;
+	best = stair;
+	if (! tile_is_empty(&(l->tile[stair.y][stair.x]))) {
+		bfs_init_terrain(&b, l);
+		bfs_add_source(&b, stair.y, stair.x);
+		(void)bfs_run(&b, NULL);
+		bestdist = -1;
+		for (int y = 0; y < MAXROWS; y++) {
+			for (int x = 0; x < MAXCOLS; x++) {
+				dist = bfs_distance(&b, y, x);
+				if (dist <= 0 || (-1 != bestdist && dist >= bestdist)
+				    || ! tile_is_empty(&(l->tile[y][x])))
+					continue;
+				bestdist = dist;
+				best.y = y;
+				best.x = x;
 			}
+		}
+		if (-1 == bestdist)
+			return;
+	}
+	t->x[i] = best.x;
+	t->y[i] = best.y;
+	level_set_creature(l, best.y, best.x, c);
 }
 
 int
-creature_move(struct creature *c, struct level *l, int row, int col)
+creature_move(struct creatures *t, uint32_t c, struct level *l, int row,
+    int col)
 {
-	if (c->y + row < 0 || c->y + row >= MAXROWS) {
+	uint32_t i = CREATURE_INDEX(c);
+	int y, x;
+
+	y = t->y[i] + row;
+	x = t->x[i] + col;
+	if (y < 0 || y >= MAXROWS) {
 		return(-1);
 	}
-	if (c->x + col < 0 || c->x + col >= MAXCOLS) {
+	if (x < 0 || x >= MAXCOLS) {
 		return(-1);
 	}
-	if (tile_is_wall(&(l->tile[c->y + row][c->x + col]))) {
+	if (tile_is_wall(&(l->tile[y][x]))) {
 		return(-1);
 	}
-	if (tile_is_empty(&(l->tile[c->y + row][c->x + col])) == false) {
+	if (tile_is_empty(&(l->tile[y][x])) == false) {
 		return(-1);
 	}
-	l->tile[c->y][c->x].creature = NULL;
-	c->y += row;
-	c->x += col;
-	l->tile[c->y][c->x].creature = c;
+	level_set_creature(l, t->y[i], t->x[i], CREATURE_NONE);
+	t->y[i] = y;
+	t->x[i] = x;
+	level_set_creature(l, y, x, c);
 	return(0);
 }
 
 int
-creature_move_left(struct creature *c, struct level* l)
+creature_move_left(struct creatures *t, uint32_t c, struct level* l)
 {
-	return(creature_move(c, l, 0, -1));
+	return(creature_move(t, c, l, 0, -1));
 }
 
 int
-creature_move_down(struct creature *c, struct level* l)
+creature_move_down(struct creatures *t, uint32_t c, struct level* l)
 {
-	return(creature_move(c, l, 1, 0));
+	return(creature_move(t, c, l, 1, 0));
 }
 
 int
-creature_move_up(struct creature *c, struct level* l)
+creature_move_up(struct creatures *t, uint32_t c, struct level* l)
 {
-	return(creature_move(c, l, -1, 0));
+	return(creature_move(t, c, l, -1, 0));
 }
 
 int
-creature_move_right(struct creature *c, struct level* l)
+creature_move_right(struct creatures *t, uint32_t c, struct level* l)
 {
-	return(creature_move(c, l, 0, 1));
+	return(creature_move(t, c, l, 0, 1));
 }
 
 int
-creature_move_upleft(struct creature *c, struct level* l)
+creature_move_upleft(struct creatures *t, uint32_t c, struct level* l)
 {
-	return(creature_move(c, l, -1, -1));
+	return(creature_move(t, c, l, -1, -1));
 }
 
 int
-creature_move_downleft(struct creature *c, struct level* l)
+creature_move_downleft(struct creatures *t, uint32_t c, struct level* l)
 {
-	return(creature_move(c, l, 1, -1));
+	return(creature_move(t, c, l, 1, -1));
 }
 
 int
-creature_move_upright(struct creature *c, struct level* l)
+creature_move_upright(struct creatures *t, uint32_t c, struct level* l)
 {
-	return(creature_move(c, l, -1, 1));
+	return(creature_move(t, c, l, -1, 1));
 }
 
 int
-creature_move_downright(struct creature *c, struct level* l)
+creature_move_downright(struct creatures *t, uint32_t c, struct level* l)
 {
-	return(creature_move(c, l, 1, 1));
+	return(creature_move(t, c, l, 1, 1));
 }
 
 int
-creature_climb_upstair(struct creature *c, struct level *f, struct level *t)
+creature_climb_upstair(struct creatures *t, uint32_t c, struct level *f,
+    struct level *to)
 {
-	if (f->tile[c->y][c->x].type != T_UPSTAIR) {
+	uint32_t i = CREATURE_INDEX(c);
+
+	if (f->tile[t->y[i]][t->x[i]].type != T_UPSTAIR) {
 		return(-1);
 	}
-	f->tile[c->y][c->x].creature = NULL;
-	creature_place_at_stair(c, t, false);
+	level_set_creature(f, t->y[i], t->x[i], CREATURE_NONE);
+	creature_place_at_stair(t, c, to, false);
 	return(0);
 }
 
 int
-creature_climb_downstair(struct creature *c, struct level *f, struct level *t)
+creature_climb_downstair(struct creatures *t, uint32_t c, struct level *f,
+    struct level *to)
 {
-	if (f->tile[c->y][c->x].type != T_DOWNSTAIR) {
+	uint32_t i = CREATURE_INDEX(c);
+
+	if (f->tile[t->y[i]][t->x[i]].type != T_DOWNSTAIR) {
 		return(-1);
 	}
-	f->tile[c->y][c->x].creature = NULL;
-	creature_place_at_stair(c, t, true);
+	level_set_creature(f, t->y[i], t->x[i], CREATURE_NONE);
+	creature_place_at_stair(t, c, to, true);
 	return(0);
 }
 
 int
-creature_rest(struct creature *c)
+creature_rest(struct creatures *t, uint32_t c)
 {
+	(void)t;
 	(void)c;
 	return(0);
 }
 
 void
-creature_do_something(struct creature *c, struct level *l)
+creature_do_something(struct creatures *t, uint32_t c, struct level *l,
+    struct distmaps *dm)
 {
+	struct coordinate from, next;
+	uint32_t i = CREATURE_INDEX(c);
 	uint32_t choice;
+	int dist;
 
-	choice = rng_rand_uniform(8);
-	switch (choice) {
-	case 0:
-		creature_move_left(c, l);
-		break;
-	case 1:
-		creature_move_down(c, l);
-		break;
-	case 2:
-		creature_move_up(c, l);
-		break;
-	case 3:
-		creature_move_right(c, l);
-		break;
-	case 4:
-		creature_move_upleft(c, l);
-		break;
-	case 5:
-		creature_move_downleft(c, l);
-		break;
-	case 6:
-		creature_move_upright(c, l);
-		break;
-	case 7:
-		creature_move_downright(c, l);
-		break;
+	from.y = t->y[i];
+	from.x = t->x[i];
+	dist = distmap_get(dm, DM_PLAYER, from.y, from.x);
+	if (dm->level == l && -1 != dist
+	    && fov_sees_viewer(l, from.y, from.x, GOBLIN_SIGHT)) {
+		if (0 == distmap_descend(dm, DM_PLAYER, l, &from, &next))
+			creature_move(t, c, l, next.y - from.y,
+			    next.x - from.x);
+		return;
 	}
+	choice = rng_stream_rand_uniform(&(t->rng[i]), 8);
+	creature_move(t, c, l, creature_dirs[choice].row,
+	    creature_dirs[choice].col);
 }
 
-static void
-human_init(struct creature *c)
+/*
+ * Take up to steps random steps over the cells set in room, which tells
+ * what cells are free on the level of the creature. The level itself is
+ * only updated if it is loaded, that is if l is not NULL.
+ */
+void
+creature_wander(struct creatures *t, uint32_t c, struct level *l,
+    struct bitboard *room, int steps)
 {
-	c->speed = 5;
-}
+	uint32_t i = CREATURE_INDEX(c);
+	uint32_t choice;
+	int y, x;
 
-static void
-goblin_init(struct creature *c)
-{
-	c->speed = 7;
+	for (; steps > 0; steps--) {
+		choice = rng_stream_rand_uniform(&(t->rng[i]), 8);
+		y = t->y[i] + creature_dirs[choice].row;
+		x = t->x[i] + creature_dirs[choice].col;
+		if (y < 0 || y >= MAXROWS || x < 0 || x >= MAXCOLS
+		    || ! BITBOARD_TEST(room, y, x))
+			continue;
+		BITBOARD_SET(room, t->y[i], t->x[i]);
+		BITBOARD_UNSET(room, y, x);
+		if (NULL != l) {
+			level_set_creature(l, t->y[i], t->x[i], CREATURE_NONE);
+			level_set_creature(l, y, x, c);
+		}
+		t->y[i] = y;
+		t->x[i] = x;
+	}
 }
-
@@ -18,7 +18,13 @@
 #define CREATURE_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
+#include "rng.h"
+
+struct arena;
+struct bitboard;
+struct distmaps;
 struct level;
 
 enum race {
@@ -27,30 +33,73 @@ enum race {
 	R__MAX,
 };
 
-struct creature {
-	int x;
-	int y;
-	int speed;
-	int actionpoints;
-	enum race race;
+/* Energy spent by an action, gathered at the speed of the creature */
+#define CREATURE_ACTIONCOST	5
+
+/*
+ * Creatures are referred to by 32 bits handles made of their index in the
+ * table and of a generation, bumped each time the slot is reused so that
+ * a stale handle never matches a newer creature. Zero is never a valid
+ * handle.
+ */
+#define CREATURE_NONE		0
+#define CREATURE_INDEXBITS	20
+#define CREATURE_MAXINDEX	((UINT32_C(1) << CREATURE_INDEXBITS) - 1)
+#define CREATURE_INDEX(h)	((h) & CREATURE_MAXINDEX)
+#define CREATURE_GENERATION(h)	((h) >> CREATURE_INDEXBITS)
+
+/*
+ * Table of every creature of a world, stored as parallel arrays so that a
+ * turn is a linear sweep over each attribute. Free slots are chained
+ * through next and their race is R__MAX. The creatures of a level are
+ * chained through sibling, by increasing index, from a head kept by the
+ * world.
+ */
+struct creatures {
+	struct arena		*arena;
+	uint32_t		 size;		/* Slots used or freed */
+	uint32_t		 capacity;
+	uint32_t		 count;		/* Living creatures */
+	uint32_t		 freelist;	/* Index of a free slot + 1 */
+	int16_t			*x;
+	int16_t			*y;
+	int16_t			*speed;
+	int16_t			*actionpoints;
+	uint8_t			*race;
+	uint16_t		*generation;
+	int32_t			*depth;		/* Level, -1 if none */
+	uint32_t		*sibling;	/* Index of the next one + 1 */
+	uint32_t		*next;
+	struct rng_stream	*rng;
 };
 
-int creature_move(struct creature *, struct level *, int, int);
-int creature_move_left(struct creature *, struct level *);
-int creature_move_down(struct creature *, struct level *);
-int creature_move_up(struct creature *, struct level *);
-int creature_move_right(struct creature *, struct level *);
-int creature_move_upleft(struct creature *, struct level *);
-int creature_move_downleft(struct creature *, struct level *);
-int creature_move_upright(struct creature *, struct level *);
-int creature_move_downright(struct creature *, struct level *);
-int creature_climb_upstair(struct creature *, struct level *, struct level *);
-int creature_climb_downstair(struct creature *, struct level *, struct level *);
-int creature_rest(struct creature *);
-void creature_init(struct creature *, enum race);
-void creature_place_randomly(struct creature *, struct level *);
-void creature_place_at_stair(struct creature *, struct level *, bool);
-void creature_do_something(struct creature *, struct level *);
+void creatures_init(struct creatures *, struct arena *);
+uint32_t creature_spawn(struct creatures *, enum race);
+void creature_despawn(struct creatures *, struct level *, uint32_t);
+bool creature_is_alive(struct creatures *, uint32_t);
+uint32_t creature_handle(struct creatures *, uint32_t);
 
-#endif
+int creature_move(struct creatures *, uint32_t, struct level *, int, int);
+int creature_move_left(struct creatures *, uint32_t, struct level *);
+int creature_move_down(struct creatures *, uint32_t, struct level *);
+int creature_move_up(struct creatures *, uint32_t, struct level *);
+int creature_move_right(struct creatures *, uint32_t, struct level *);
+int creature_move_upleft(struct creatures *, uint32_t, struct level *);
+int creature_move_downleft(struct creatures *, uint32_t, struct level *);
+int creature_move_upright(struct creatures *, uint32_t, struct level *);
+int creature_move_downright(struct creatures *, uint32_t, struct level *);
+int creature_climb_upstair(struct creatures *, uint32_t, struct level *,
+    struct level *);
+int creature_climb_downstair(struct creatures *, uint32_t, struct level *,
+    struct level *);
+int creature_rest(struct creatures *, uint32_t);
+void creature_place_randomly(struct creatures *, uint32_t, struct level *,
+    struct rng *);
+void creature_place_at_stair(struct creatures *, uint32_t, struct level *,
+    bool);
+void creature_do_something(struct creatures *, uint32_t, struct level *,
+    struct distmaps *);
+void creature_wander(struct creatures *, uint32_t, struct level *,
+    struct bitboard *, int);
 
+#endif
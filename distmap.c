@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "level.h"
+#include "pathfind.h"
+#include "distmap.h"
+
+void
+distmaps_init(struct distmaps *dm)
+{
+	dm->level = NULL;
+	for (int i = 0; i < DM__MAX; i++)
+		dm->valid[i] = false;
+}
+
+/*
+ * Called once per turn with the position of the player.
+ */
+void
+distmaps_update(struct distmaps *dm, struct level *l, struct coordinate *player)
+{
+	struct bfs *b;
+
+	dm->level = l;
+	b = &(dm->map[DM_PLAYER]);
+	bfs_init_terrain(b, l);
+	dm->valid[DM_PLAYER] = false;
+	if (-1 == bfs_add_source(b, player->y, player->x))
+		return;
+	(void)bfs_run(b, NULL);
+	dm->valid[DM_PLAYER] = true;
+}
+
+/*
+ * Distance between (y, x) and the goal, or -1 if unknown or unreachable.
+ */
+int
+distmap_get(struct distmaps *dm, enum distmap_goal goal, int y, int x)
+{
+	if (! dm->valid[goal])
+		return(-1);
+	return(bfs_distance(&(dm->map[goal]), y, x));
+}
+
+/*
+ * Find the free neighbour of from which is the closest to the goal and
+ * store it in next. Return -1 if there is no way to get closer.
+ */
+int
+distmap_descend(struct distmaps *dm, enum distmap_goal goal, struct level *l,
+    struct coordinate *from, struct coordinate *next)
+{
+	int best;
+
+	if (dm->level != l)
+		return(-1);
+	best = distmap_get(dm, goal, from->y, from->x);
+	if (-1 == best)
+		return(-1);
+	next->y = -1;
+	next->x = -1;
+	for (int y = from->y - 1; y <= from->y + 1; y++) {
+		for (int x = from->x - 1; x <= from->x + 1; x++) {
+			int dist;
+
+			dist = distmap_get(dm, goal, y, x);
+			if (-1 == dist || dist >= best)
+				continue;
+			if (! tile_is_empty(&(l->tile[y][x])))
+				continue;
+			best = dist;
+			next->y = y;
+			next->x = x;
+		}
+	}
+	if (-1 == next->y)
+		return(-1);
+	return(0);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DISTMAP_H__
+#define DISTMAP_H__
+
+#include <stdbool.h>
+
+struct coordinate;
+struct level;
+
+enum distmap_goal {
+	DM_PLAYER,
+	DM__MAX,
+};
+
+/*
+ * Distance maps of a level toward a set of goals, shared by every creature
+ * of this level.
+ */
+struct distmaps {
+	struct level	*level;
+	bool		 valid[DM__MAX];
+	struct bfs	 map[DM__MAX];
+};
+
+void distmaps_init(struct distmaps *);
+void distmaps_update(struct distmaps *, struct level *, struct coordinate *);
+int distmap_get(struct distmaps *, enum distmap_goal, int, int);
+int distmap_descend(struct distmaps *, enum distmap_goal, struct level *,
+    struct coordinate *, struct coordinate *);
+
+#endif
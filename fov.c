@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * Field of view by symmetric recursive shadowcasting: each octant around
+ * the viewer is scanned row after row, the rows getting narrower as walls
+ * cast their shadows, and a row split by a wall is scanned again on each
+ * side. An open cell is only visible if its centre is within the slopes of
+ * the row, which makes sight symmetric: if a cell sees another, the other
+ * sees it as well. Creatures can thus tell if they see the player by
+ * looking at what the player sees.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "level.h"
+
+/* Slope of a line from the viewer, num / den with den > 0 */
+struct slope {
+	int	 num;
+	int	 den;
+};
+
+/*
+ * Transforms from the rows and columns of an octant to the level: the
+ * column is multiplied by the first pair and the row by the second.
+ */
+static const int octants[8][4] = {
+	{  1,  0,  0,  1 },
+	{  0,  1,  1,  0 },
+	{  0, -1,  1,  0 },
+	{ -1,  0,  0,  1 },
+	{ -1,  0,  0, -1 },
+	{  0, -1, -1,  0 },
+	{  0,  1, -1,  0 },
+	{  1,  0,  0, -1 },
+};
+
+struct scan {
+	struct bitboard		*visible;
+	const struct bitboard	*opaque;
+	const int		*octant;
+	int			 y;
+	int			 x;
+	int			 radius;
+};
+
+static int
+floordiv(int a, int b)
+{
+	return(a / b - (a % b != 0 && (a < 0) != (b < 0)));
+}
+
+static int
+ceildiv(int a, int b)
+{
+	return(-floordiv(-a, b));
+}
+
+/*
+ * Map the cell of the octant to the level, return false if it is out of it.
+ */
+static bool
+fov_cell(const struct scan *s, int row, int col, int *y, int *x)
+{
+	*x = s->x + col * s->octant[0] + row * s->octant[1];
+	*y = s->y + col * s->octant[2] + row * s->octant[3];
+	return(*y >= 0 && *y < MAXROWS && *x >= 0 && *x < MAXCOLS);
+}
+
+static void
+fov_scan(const struct scan *s, int row, struct slope start, struct slope end)
+{
+	struct slope	 next;
+	int		 mincol, maxcol, y, x;
+	int		 prev = -1;	/* Wall or not, -1 before the first */
+
+	if (row > s->radius)
+		return;
+	/* Columns whose centre is within the slopes, ties toward the inside */
+	mincol = floordiv(2 * row * start.num + start.den, 2 * start.den);
+	maxcol = ceildiv(2 * row * end.num - end.den, 2 * end.den);
+	for (int col = mincol; col <= maxcol; col++) {
+		bool inside, wall;
+
+		inside = fov_cell(s, row, col, &y, &x);
+		wall = ! inside || BITBOARD_TEST(s->opaque, y, x);
+		if (inside && row * row + col * col <= s->radius * (s->radius + 1)
+		    && (wall || (col * start.den >= row * start.num
+		    && col * end.den <= row * end.num)))
+			BITBOARD_SET(s->visible, y, x);
+		if (1 == prev && ! wall) {
+			start.num = 2 * col - 1;
+			start.den = 2 * row;
+		}
+		if (0 == prev && wall) {
+			next.num = 2 * col - 1;
+			next.den = 2 * row;
+			fov_scan(s, row + 1, start, next);
+		}
+		prev = wall;
+	}
+	if (0 == prev)
+		fov_scan(s, row + 1, start, end);
+}
+
+/*
+ * Set in visible the cells seen from (y, x) up to radius cells away, the
+ * walls being the cells set in opaque.
+ */
+void
+fov_compute(struct bitboard *visible, const struct bitboard *opaque,
+    int y, int x, int radius)
+{
+	struct scan	 s;
+	struct slope	 start = { 0, 1 }, end = { 1, 1 };
+
+	bitboard_clear(visible);
+	BITBOARD_SET(visible, y, x);
+	s.visible = visible;
+	s.opaque = opaque;
+	s.y = y;
+	s.x = x;
+	s.radius = radius;
+	for (int i = 0; i < 8; i++) {
+		s.octant = octants[i];
+		fov_scan(&s, 1, start, end);
+	}
+}
+
+/*
+ * Move the viewer of the level to (y, x) and update what it sees, unless
+ * it did not move and no wall changed in its range. The cells whose
+ * visibility changed, and those next to the cells seen for the first time,
+ * are marked dirty. Return true if the field of view was computed again.
+ */
+bool
+fov_update(struct level *l, int y, int x)
+{
+	struct bitboard	 seen, fresh;
+	bool		 first;
+
+	if (! l->viewstale && y == l->viewer.y && x == l->viewer.x)
+		return(false);
+	first = -1 == l->viewer.y;
+	fov_compute(&seen, &(l->wall), y, x, FOV_RADIUS);
+	for (int r = 0; r < MAXROWS; r++) {
+		for (int w = 0; w < BITBOARD_WORDS; w++) {
+			fresh.row[r][w] = seen.row[r][w] &
+			    ~l->remembered.row[r][w];
+			/* Everything was drawn when there was no viewer */
+			if (first)
+				l->dirty.row[r][w] = ~UINT64_C(0);
+			else
+				l->dirty.row[r][w] |=
+				    l->visible.row[r][w] ^ seen.row[r][w];
+			l->remembered.row[r][w] |= seen.row[r][w];
+		}
+	}
+	/* The walls next to the cells seen for the first time join them */
+	bitboard_dilate(&fresh, &fresh);
+	for (int r = 0; r < MAXROWS; r++)
+		for (int w = 0; w < BITBOARD_WORDS; w++)
+			l->dirty.row[r][w] |= fresh.row[r][w];
+	l->visible = seen;
+	l->viewer.y = y;
+	l->viewer.x = x;
+	l->viewstale = false;
+	return(true);
+}
+
+/*
+ * Tell if a creature at (y, x) sees the viewer of the level, up to radius
+ * cells away. Sight being symmetric, it does if the viewer sees it.
+ */
+bool
+fov_sees_viewer(struct level *l, int y, int x, int radius)
+{
+	int dy = y - l->viewer.y;
+	int dx = x - l->viewer.x;
+
+	if (-1 == l->viewer.y || ! BITBOARD_TEST(&(l->visible), y, x))
+		return(false);
+	return(dy * dy + dx * dx <= radius * (radius + 1));
+}
@@ -35,7 +35,11 @@
 #include "ui.h"
 #include "creature.h"
 #include "options.h"
+#include "pathfind.h"
+#include "distmap.h"
 #include "world.h"
+#include "session.h"
+#include "replay.h"
 #include "rng.h"
 
 static void usage(void);
@@ -53,8 +57,9 @@ default_config_file(void) {
 	if (success == -1) {
 		log_debug("--- Default configuration file ---\n");
 		log_debug("%s: %s\n", filename, strerror(errno));
-		/* Colors are turned on by default. */
+		/* Colors and box walls are turned on by default. */
 		optionsmap[O_COLORS].value = true;
+		optionsmap[O_BOXWALLS].value = true;
 	}
 
 	return success;
@@ -138,26 +143,44 @@ config_file_read(const char *configfile)
 int
 main(int argc, char *argv[])
 {
-	int		 ch, is_running;
+	int		 ch;
+	int		 fps = 30;
+	int32_t		 depth = WORLD_DEPTH;
 	bool		 debug = false;
 	uint32_t	 seed;
 	glob_t		 gl;
 	char		 path[PATH_MAX];
-	struct creature	 p;
-	struct world	 w;
+	struct session	 s;
+	struct replay	 r;
 	char		*configfile = NULL;
+	char		*recordfile = NULL;
 	const char	*errstr;
 	struct level	*lp;
 	struct passwd	*pw;
 
-	while ((ch = getopt(argc, argv, "df:s:")) != -1) {
+	while ((ch = getopt(argc, argv, "dF:f:l:r:s:")) != -1) {
 		switch (ch) {
 		case 'd':
 			debug = true;
 			break;
+		case 'F':
+			fps = strtonum(optarg, 0, 1000, &errstr);
+			if (errstr != NULL) {
+				errx(1, "invalid frame rate");
+			}
+			break;
 		case 'f':
 			configfile = optarg;
 			break;
+		case 'l':
+			depth = strtonum(optarg, 2, INT32_MAX, &errstr);
+			if (errstr != NULL) {
+				errx(1, "invalid number of levels");
+			}
+			break;
+		case 'r':
+			recordfile = optarg;
+			break;
 		case 's':
 			seed = strtonum(optarg, 0, UINT32_MAX, &errstr);
 			if (errstr != NULL) {
@@ -213,18 +236,18 @@ main(int argc, char *argv[])
 		goto exit;
 	}
 
-	is_running = -1;
-	log_debug("--- world ---\n");
-	world_init(&w);
-	lp = world_first(&w);
-	log_debug("--- creature (hero) ---\n");
-	creature_init(&p, R_HUMAN);
-	creature_place_at_stair(&p, lp, true);
+	if (NULL != recordfile &&
+	    -1 == replay_record(&r, recordfile, rng_get_seed(), depth)) {
+		ui_cleanup();
+		err(1, "%s", recordfile);
+	}
+	ui_set_fps(fps);
+	session_init(&s, rng_get_seed(), depth);
 	log_debug("--- start game ---\n");
 	do {
-		int key, noaction;
+		int key, res;
 
-		noaction = 0;
+		lp = s.lp;
 		if (false == lp->visited) {
 			if (true == debug)
 				ui_message("Seed: %u", rng_get_seed());
@@ -234,134 +257,38 @@ main(int argc, char *argv[])
 				ui_message(lp->entrymessage);
 			lp->visited = true;
 		}
-		ui_draw(lp);
-		p.actionpoints += p.speed;
-		while (p.actionpoints >= 5) {
-			if (-1 != is_running) {
-				key = is_running;
+		/* Runs are only drawn as often as the frame rate allows */
+		if (-1 != s.running)
+			ui_frame(lp);
+		for (;;) {
+			if (-1 != s.running) {
+				key = s.running;
 			} else {
+				ui_draw(s.lp);
 				key = keybinding_resolve(ui_get_input());
 			}
 			if (key == K__MAX) {
 				continue;
 			}
-			switch (key) {
-			case K_RUNLEFT:
-				is_running = K_LEFT;
-				/* FALLTHROUGH */
-			case K_LEFT:
-				noaction = creature_move_left(&p, lp);
-				break;
-			case K_RUNDOWN:
-				is_running = K_DOWN;
-				/* FALLTHROUGH */
-			case K_DOWN:
-				noaction = creature_move_down(&p, lp);
-				break;
-			case K_RUNUP:
-				is_running = K_UP;
-				/* FALLTHROUGH */
-			case K_UP:
-				noaction = creature_move_up(&p, lp);
-				break;
-			case K_RUNRIGHT:
-				is_running = K_RIGHT;
-				/* FALLTHROUGH */
-			case K_RIGHT:
-				noaction = creature_move_right(&p, lp);
-				break;
-			case K_RUNUPLEFT:
-				is_running = K_UPLEFT;
-				/* FALLTHROUGH */
-			case K_UPLEFT:
-				noaction = creature_move_upleft(&p, lp);
-				break;
-			case K_RUNUPRIGHT:
-				is_running = K_UPRIGHT;
-				/* FALLTHROUGH */
-			case K_UPRIGHT:
-				noaction = creature_move_upright(&p, lp);
-				break;
-			case K_RUNDOWNLEFT:
-				is_running = K_DOWNLEFT;
-				/* FALLTHROUGH */
-			case K_DOWNLEFT:
-				noaction = creature_move_downleft(&p, lp);
-				break;
-			case K_RUNDOWNRIGHT:
-				is_running = K_DOWNRIGHT;
-				/* FALLTHROUGH */
-			case K_DOWNRIGHT:
-				noaction = creature_move_downright(&p, lp);
+			if (NULL != recordfile && -1 == s.running)
+				replay_record_key(&r, key);
+			if (1 == (res = session_key(&s, key)))
+				goto quit;
+			if (0 == res)
 				break;
-			case K_UPSTAIR:
-				if (lp == world_first(&w)) {
-					noaction = -1;
-					break;
-				}
-				noaction = creature_climb_upstair(&p, lp, world_prev(&w));
-				lp = world_current(&w);
-				break;
-			case K_DOWNSTAIR:
-				noaction = creature_climb_downstair(&p, lp, world_next(&w));
-				lp = world_current(&w);
-				break;
-			case K_REST:
-				noaction = creature_rest(&p);
-				break;
-			case K_LOOKHERE:
-				ui_look(lp, p.y, p.x);
-				ui_draw(lp);
-				noaction = -1;
-				break;
-			case K_LOOKELSEWHERE:
-				ui_look_elsewhere(lp, p.y, p.x);
-				ui_draw(lp);
-				noaction = -1;
-				break;
-			case K_OPTIONMENU:
-				ui_menu_options();
-				ui_draw(lp);
-				noaction = -1;
-				break;
-			case K_HELPMENU:
-				ui_menu_help();
-				ui_draw(lp);
-				noaction = -1;
-				break;
-			case K_QUIT:
-				goto exit;
-			default:
-				noaction = -1;
-				break;
-			}
-			if (noaction == -1) {
-				is_running = -1;
-				continue;
-			}
-			p.actionpoints -= 5;
-		}
-		/* Monsters' turn */
-		for (int32_t i = 0; i < w.creaturesz; i++) {
-			struct creature *c;
-
-			c = w.creatures[i];
-			c->actionpoints += c->speed;
-			while (c->actionpoints >= 5) {
-				creature_do_something(c, world_first(&w));
-				c->actionpoints -= 5;
-			}
-		}
-		/* Add a slight delay when running */
-		if (-1 != is_running) {
-			ui_pause(0, 100);
 		}
+		session_end_turn(&s);
+		if (NULL != recordfile)
+			replay_record_turn(&r, session_hash(&s));
 	} while (1);
+quit:
+	session_free(&s);
+	if (NULL != recordfile)
+		replay_close(&r);
 exit:
 	if (true == debug) {
 		log_close();
 	}
-	world_free(&w);
 	ui_cleanup();
 	return(0);
 }
@@ -369,7 +296,8 @@ exit:
 static void
 usage(void)
 {
-	fprintf(stderr, "usage: %s [-d] [-f file] [-s seed]\n", getprogname());
+	fprintf(stderr, "usage: %s [-d] [-F fps] [-f file] [-l levels] [-r file] "
+	    "[-s seed]\n", getprogname());
 	exit(1);
 }
 
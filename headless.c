@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <err.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "level.h"
+#include "ui.h"
+#include "creature.h"
+#include "options.h"
+#include "pathfind.h"
+#include "distmap.h"
+#include "world.h"
+#include "session.h"
+#include "render.h"
+#include "replay.h"
+#include "rng.h"
+
+/* Keys tried by the random player before giving up and resting */
+#define MAXTRIES 64
+
+/*
+ * Keys drawn by the random player. Moves are the most likely, then
+ * travelling and climbing the stairs so that the whole world gets visited.
+ */
+static const int randomkeys[] = {
+	K_LEFT, K_DOWN, K_UP, K_RIGHT,
+	K_UPLEFT, K_UPRIGHT, K_DOWNLEFT, K_DOWNRIGHT,
+	K_LEFT, K_DOWN, K_UP, K_RIGHT,
+	K_UPLEFT, K_UPRIGHT, K_DOWNLEFT, K_DOWNRIGHT,
+	K_RUNLEFT, K_RUNDOWN, K_RUNUP, K_RUNRIGHT,
+	K_REST, K_TRAVEL, K_DOWNSTAIR, K_UPSTAIR,
+};
+
+enum phase {
+	PHASE_INPUT,
+	PHASE_PLAYER,
+	PHASE_WORLD,
+	PHASE_RENDER,
+	PHASE__MAX,
+};
+
+static const char *phasenames[PHASE__MAX] = {
+	"input",
+	"player",
+	"world",
+	"render",
+};
+
+static double	 phasetimes[PHASE__MAX];
+
+static void usage(void);
+
+static double
+now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/*
+ * Give the next key of the script, or K_QUIT once it is over.
+ */
+static int
+script_key(FILE *script)
+{
+	int c, key;
+
+	while (EOF != (c = fgetc(script))) {
+		if ('\n' == c)
+			continue;
+		if (K__MAX != (key = keybinding_resolve(c)))
+			return(key);
+	}
+	return(K_QUIT);
+}
+
+/*
+ * Play one action of the player, from the replay or the script if there is
+ * one or at random otherwise, then check or record the resulting state.
+ * Return 1 when the game is over and -1 if the replay diverged.
+ */
+static int
+play(struct session *s, FILE *script, struct rng_stream *input,
+    struct replay *r, bool replaying)
+{
+	double	 start, input_end;
+	int	 key, res, tries;
+
+	tries = 0;
+	do {
+		start = now();
+		if (-1 != s->running)
+			key = s->running;
+		else if (replaying)
+			key = replay_key(r);
+		else if (NULL != script)
+			key = script_key(script);
+		else if (tries++ < MAXTRIES)
+			key = randomkeys[rng_stream_rand_uniform(input,
+			    sizeof(randomkeys) / sizeof(randomkeys[0]))];
+		else
+			key = K_REST;
+		if (!replaying && NULL != r->f && -1 == s->running)
+			replay_record_key(r, key);
+		input_end = now();
+		phasetimes[PHASE_INPUT] += input_end - start;
+		res = session_key(s, key);
+		phasetimes[PHASE_PLAYER] += now() - input_end;
+	} while (-1 == res);
+	if (1 == res)
+		return(1);
+	start = now();
+	session_end_turn(s);
+	phasetimes[PHASE_WORLD] += now() - start;
+	if (replaying)
+		return(replay_check_turn(r, session_hash(s)));
+	if (NULL != r->f)
+		replay_record_turn(r, session_hash(s));
+	return(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct session		 s;
+	struct rng_stream	 input;
+	struct replay		 r;
+	struct renderer		 view, *vp = NULL;
+	struct pacer		 pacer;
+	FILE			*script = NULL, *stats = stdout;
+	const char		*recordfile = NULL, *replayfile = NULL;
+	const char		*backend = NULL;
+	uint64_t		 turns = 0;
+	uint32_t		 seed;
+	int32_t			 depth = WORLD_DEPTH;
+	double			 start, elapsed;
+	const char		*errstr;
+	bool			 debug = false;
+	int			 ch, res = 0, fps = 30;
+
+	while (-1 != (ch = getopt(argc, argv, "dF:i:l:n:p:R:r:s:"))) {
+		switch (ch) {
+		case 'd':
+			debug = true;
+			break;
+		case 'F':
+			fps = strtonum(optarg, 0, 1000, &errstr);
+			if (NULL != errstr)
+				errx(1, "invalid frame rate");
+			break;
+		case 'i':
+			if (NULL == (script = fopen(optarg, "r")))
+				err(1, "%s", optarg);
+			break;
+		case 'l':
+			depth = strtonum(optarg, 2, INT32_MAX, &errstr);
+			if (NULL != errstr)
+				errx(1, "invalid number of levels");
+			break;
+		case 'n':
+			turns = strtonum(optarg, 1, LLONG_MAX, &errstr);
+			if (NULL != errstr)
+				errx(1, "invalid number of turns");
+			break;
+		case 'p':
+			replayfile = optarg;
+			break;
+		case 'R':
+			backend = optarg;
+			break;
+		case 'r':
+			recordfile = optarg;
+			break;
+		case 's':
+			rng_set_seed(strtonum(optarg, 0, UINT32_MAX, &errstr));
+			if (NULL != errstr)
+				errx(1, "invalid seed value");
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (0 != argc || (NULL != replayfile &&
+	    (NULL != recordfile || NULL != script)))
+		usage();
+
+	if (debug)
+		log_open("debug.log");
+	if (NULL != backend) {
+		vp = &view;
+		if (0 == strcmp(backend, "ansi")) {
+			if (-1 == render_ansi_init(vp, STDOUT_FILENO, 0))
+				err(1, "render_ansi_init");
+			/* Keep the frames apart from the statistics */
+			stats = stderr;
+		} else if (0 == strcmp(backend, "memory")) {
+			if (-1 == render_memory_init(vp))
+				err(1, "render_memory_init");
+		} else
+			usage();
+		optionsmap[O_COLORS].value = true;
+		optionsmap[O_BOXWALLS].value = true;
+		render_build_glyphs();
+		pacer_init(&pacer, fps);
+	}
+	r.f = NULL;
+	if (NULL != replayfile) {
+		/* A replay plays until its end unless told otherwise */
+		if (-1 == replay_open(&r, replayfile, &seed, &depth))
+			errx(1, "%s: not a valid replay", replayfile);
+		rng_set_seed(seed);
+		if (0 == turns)
+			turns = UINT64_MAX;
+	}
+	if (0 == turns)
+		turns = 10000;
+	rng_init();
+	if (NULL != recordfile &&
+	    -1 == replay_record(&r, recordfile, rng_get_seed(), depth))
+		err(1, "%s", recordfile);
+	rng_stream_init(&input, rng_get_seed(), RNG_INPUT, 0);
+	session_init(&s, rng_get_seed(), depth);
+	start = now();
+	while (s.turns < turns) {
+		if (0 != (res = play(&s, script, &input, &r,
+		    NULL != replayfile)))
+			break;
+		if (NULL != vp) {
+			double render_start = now();
+
+			if (s.spotted)
+				pacer_urge(&pacer);
+			render_paced(vp, &pacer, s.lp);
+			phasetimes[PHASE_RENDER] += now() - render_start;
+		}
+	}
+	elapsed = now() - start;
+	if (NULL != vp) {
+		/* Whatever was skipped, the last frame is drawn */
+		pacer_urge(&pacer);
+		render_paced(vp, &pacer, s.lp);
+		if (0 == strcmp(backend, "memory"))
+			render_memory_print(vp, stdout);
+		render_free(vp);
+	}
+	if (-1 == res)
+		fprintf(stderr, "%s: diverged at turn %llu\n", replayfile,
+		    (unsigned long long)s.turns);
+
+	fprintf(stats, "seed: %u\n", rng_get_seed());
+	fprintf(stats, "turns: %llu\n", (unsigned long long)s.turns);
+	fprintf(stats, "world turns: %llu\n", (unsigned long long)s.w.turn);
+	fprintf(stats, "level: %i\n", s.w.current);
+	fprintf(stats, "seconds: %.3f\n", elapsed);
+	fprintf(stats, "turns/second: %.0f\n", s.turns / elapsed);
+	for (int i = 0; i < PHASE__MAX; i++)
+		fprintf(stats, "%s: %.3f s, %.2f us/turn\n", phasenames[i],
+		    phasetimes[i], s.turns > 0 ?
+		    phasetimes[i] * 1e6 / s.turns : 0.0);
+	if (NULL != vp)
+		fprintf(stats, "frames: %llu drawn, %llu skipped\n",
+		    (unsigned long long)pacer.drawn,
+		    (unsigned long long)pacer.skipped);
+	if (NULL != replayfile)
+		fprintf(stats, "hashes checked: %llu\n",
+		    (unsigned long long)r.checked);
+	session_free(&s);
+	if (NULL != r.f)
+		replay_close(&r);
+	if (NULL != script)
+		fclose(script);
+	if (debug)
+		log_close();
+	return(-1 == res ? 1 : 0);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-d] [-F fps] [-i script | -p replay] "
+	    "[-l levels] [-n turns] [-R ansi | memory] [-r replay] "
+	    "[-s seed]\n", getprogname());
+	exit(1);
+}
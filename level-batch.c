@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <err.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "level.h"
+#include "rng.h"
+
+/* Number of tries to generate a level before giving up */
+#define MAXATTEMPTS 10
+
+/*
+ * Each worker owns a range of seeds and takes them from its beginning.
+ * Once its range is empty it steals the second half of the largest range
+ * left to another worker.
+ */
+struct worker {
+	pthread_t	 thread;
+	pthread_mutex_t	 lock;
+	uint64_t	 next;
+	uint64_t	 end;
+	/* Scratch space of the worker, allocated once */
+	struct rng	 rng;
+	struct level	 level;
+	/* Statistics */
+	uint64_t	 levels;
+	uint64_t	 retries;
+	uint64_t	 failures;
+	uint64_t	 steals;
+};
+
+static struct worker	*workers;
+static int		 workersz;
+static uint32_t		 levelindex = 1;
+static pthread_mutex_t	 outputlock = PTHREAD_MUTEX_INITIALIZER;
+
+static void usage(void);
+
+static bool
+worker_take(struct worker *wk, uint32_t *seed)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&(wk->lock));
+	if (wk->next < wk->end) {
+		*seed = (uint32_t)wk->next;
+		wk->next += 1;
+		found = true;
+	}
+	pthread_mutex_unlock(&(wk->lock));
+	return(found);
+}
+
+static bool
+worker_steal(struct worker *wk)
+{
+	struct worker	*victim;
+	uint64_t	 left, half, newend;
+
+	victim = NULL;
+	left = 0;
+	for (int i = 0; i < workersz; i++) {
+		uint64_t l;
+
+		if (&(workers[i]) == wk)
+			continue;
+		pthread_mutex_lock(&(workers[i].lock));
+		l = workers[i].end - workers[i].next;
+		pthread_mutex_unlock(&(workers[i].lock));
+		if (l > left) {
+			left = l;
+			victim = &(workers[i]);
+		}
+	}
+	if (NULL == victim)
+		return(false);
+	pthread_mutex_lock(&(victim->lock));
+	left = victim->end - victim->next;
+	half = left / 2;
+	if (0 == half && 1 == left)
+		half = 1;
+	victim->end -= half;
+	/* Another thief may shrink it again as soon as it is unlocked */
+	newend = victim->end;
+	pthread_mutex_unlock(&(victim->lock));
+	if (0 == half)
+		return(true);
+	pthread_mutex_lock(&(wk->lock));
+	wk->next = newend;
+	wk->end = newend + half;
+	pthread_mutex_unlock(&(wk->lock));
+	wk->steals += 1;
+	return(true);
+}
+
+/*
+ * Generate the level the same way as the random caves of the game.
+ */
+static void
+generate(struct worker *wk, uint32_t seed)
+{
+	int attempt;
+
+	rng_init_stream(&(wk->rng), seed, RNG_LEVEL, levelindex);
+	for (attempt = 0; attempt < MAXATTEMPTS; attempt++) {
+		level_init(&(wk->level));
+		cave_gen(&(wk->level), NULL, &(wk->rng));
+		level_cull_pockets(&(wk->level));
+		if (0 == level_add_stairs(&(wk->level), true, true,
+		    &(wk->rng)))
+			break;
+		/* The last attempt is a failure, not a retry */
+		if (attempt + 1 < MAXATTEMPTS)
+			wk->retries += 1;
+	}
+	wk->levels += 1;
+	if (MAXATTEMPTS == attempt) {
+		wk->failures += 1;
+		pthread_mutex_lock(&outputlock);
+		printf("%u: failed\n", seed);
+		pthread_mutex_unlock(&outputlock);
+	}
+}
+
+static void *
+worker_main(void *arg)
+{
+	struct worker	*wk = arg;
+	uint32_t	 seed;
+
+	for (;;) {
+		while (worker_take(wk, &seed))
+			generate(wk, seed);
+		if (! worker_steal(wk))
+			break;
+	}
+	return(NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct timespec	 start, end;
+	uint64_t	 first, last, total, chunk;
+	uint64_t	 levels, retries, failures, steals;
+	double		 elapsed;
+	const char	*errstr;
+	int		 ch;
+
+	workersz = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workersz < 1)
+		workersz = 1;
+	while ((ch = getopt(argc, argv, "j:l:")) != -1) {
+		switch (ch) {
+		case 'j':
+			workersz = strtonum(optarg, 1, 1024, &errstr);
+			if (errstr != NULL)
+				errx(1, "invalid number of threads");
+			break;
+		case 'l':
+			levelindex = strtonum(optarg, 0, INT32_MAX, &errstr);
+			if (errstr != NULL)
+				errx(1, "invalid level index");
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2) {
+		warnx("seed range expected");
+		usage();
+	}
+	first = strtonum(argv[0], 0, UINT32_MAX, &errstr);
+	if (errstr != NULL)
+		errx(1, "invalid first seed");
+	last = strtonum(argv[1], first, UINT32_MAX, &errstr);
+	if (errstr != NULL)
+		errx(1, "invalid last seed");
+
+	if (NULL == (workers = calloc(workersz, sizeof(struct worker))))
+		err(1, "calloc");
+	total = last - first + 1;
+	chunk = total / workersz;
+	for (int i = 0; i < workersz; i++) {
+		pthread_mutex_init(&(workers[i].lock), NULL);
+		workers[i].next = first + i * chunk;
+		workers[i].end = workers[i].next + chunk;
+	}
+	workers[workersz - 1].end = last + 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < workersz; i++)
+		if (0 != pthread_create(&(workers[i].thread), NULL,
+		    worker_main, &(workers[i])))
+			errx(1, "pthread_create");
+	levels = retries = failures = steals = 0;
+	for (int i = 0; i < workersz; i++) {
+		pthread_join(workers[i].thread, NULL);
+		levels += workers[i].levels;
+		retries += workers[i].retries;
+		failures += workers[i].failures;
+		steals += workers[i].steals;
+	}
+	/* The workers still running lock all the others when stealing */
+	for (int i = 0; i < workersz; i++)
+		pthread_mutex_destroy(&(workers[i].lock));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start.tv_sec)
+	    + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("threads: %i\n", workersz);
+	printf("levels: %llu\n", (unsigned long long)levels);
+	printf("retries: %llu\n", (unsigned long long)retries);
+	printf("failures: %llu\n", (unsigned long long)failures);
+	printf("steals: %llu\n", (unsigned long long)steals);
+	printf("seconds: %.3f\n", elapsed);
+	printf("levels/second: %.0f\n", levels / elapsed);
+	free(workers);
+	return(failures == 0 ? 0 : 2);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-j threads] [-l level] first last\n",
+	    getprogname());
+	exit(1);
+}
@@ -56,8 +56,11 @@ main(int argc, char *argv[])
 	rng_init();
 	ui_init();
 	level_init(&l);
-	cave_gen(&l);
-	level_load(&l, "misc/entry");
+	cave_gen(&l, NULL, rng_default());
+	if (-1 == level_load(&l, "misc/entry", &errstr)) {
+		ui_cleanup();
+		errx(1, "misc/entry: %s", errstr);
+	}
 
 	ui_draw(&l);
 	(void)ui_get_input();
@@ -26,7 +26,6 @@
 #include "config.h"
 #include "creature.h"
 #include "level.h"
-#include "pathfind.h"
 #include "rng.h"
 #include "ui.h"
 
@@ -73,7 +72,7 @@ string_to_coordinate(char *src, struct coordinate *c)
 bool
 tile_is_empty(struct tile *t) {
 	if ((T_EMPTY == t->type || T_UPSTAIR == t->type
-	    || T_DOWNSTAIR == t->type) && NULL == t->creature)
+	    || T_DOWNSTAIR == t->type) && CREATURE_NONE == t->creature)
 		return(true);
 	return(false);
 }
@@ -90,16 +89,119 @@ level_init(struct level *l) {
 	l->type = L_NONE;
 	l->visited = false;
 	l->entrymessage = NULL;
+	l->creatures = NULL;
 	for (int y = 0; y < MAXROWS; y++) {
 		for (int x = 0; x < MAXCOLS; x++) {
 			l->tile[y][x].type = T_EMPTY;
-			l->tile[y][x].creature = NULL;
+			l->tile[y][x].creature = CREATURE_NONE;
+			l->component[y][x] = 0;
 		}
 	}
+	l->componentsz = 0;
+	bitboard_clear(&(l->visible));
+	bitboard_clear(&(l->remembered));
+	l->viewer.y = -1;
+	l->viewer.x = -1;
+	l->viewstale = false;
+	level_sync(l);
 }
 
+const struct coordinate level_neighbours[8] = {
+	{ 0, -1}, { 1, -1}, { 1,  0}, { 1,  1},
+	{ 0,  1}, {-1,  1}, {-1,  0}, {-1, -1},
+};
+
+static bool
+level_contains(int y, int x)
+{
+	return(y >= 0 && y < MAXROWS && x >= 0 && x < MAXCOLS);
+}
+
+/*
+ * Every change of a tile must go through these mutators to keep the
+ * bitboards of the level in sync.
+ */
 void
-level_load(struct level *l, const char *filename)
+level_set_type(struct level *l, int y, int x, enum tile_type type)
+{
+	bool wall;
+
+	wall = T_WALL == l->tile[y][x].type;
+	l->tile[y][x].type = type;
+	BITBOARD_SET(&(l->dirty), y, x);
+	if (T_WALL == type)
+		BITBOARD_SET(&(l->wall), y, x);
+	else
+		BITBOARD_UNSET(&(l->wall), y, x);
+	if (T_EMPTY == type || T_UPSTAIR == type || T_DOWNSTAIR == type)
+		BITBOARD_SET(&(l->walkable), y, x);
+	else
+		BITBOARD_UNSET(&(l->walkable), y, x);
+	if (wall == (T_WALL == type))
+		return;
+	if (-1 != l->viewer.y && abs(y - l->viewer.y) <= FOV_RADIUS
+	    && abs(x - l->viewer.x) <= FOV_RADIUS)
+		l->viewstale = true;
+	/* The neighbours see this cell from the opposite direction */
+	for (int i = 0; i < 8; i++) {
+		int ny = y + level_neighbours[i].y;
+		int nx = x + level_neighbours[i].x;
+
+		if (! level_contains(ny, nx))
+			continue;
+		l->wallmask[ny][nx] ^= 1 << ((i + 4) % 8);
+		BITBOARD_SET(&(l->dirty), ny, nx);
+	}
+}
+
+void
+level_set_creature(struct level *l, int y, int x, uint32_t c)
+{
+	l->tile[y][x].creature = c;
+	BITBOARD_SET(&(l->dirty), y, x);
+	if (CREATURE_NONE != c)
+		BITBOARD_SET(&(l->occupied), y, x);
+	else
+		BITBOARD_UNSET(&(l->occupied), y, x);
+}
+
+/*
+ * Rebuild the bitboards after tiles were modified in bulk.
+ */
+void
+level_sync(struct level *l)
+{
+	bitboard_clear(&(l->wall));
+	bitboard_clear(&(l->walkable));
+	bitboard_clear(&(l->occupied));
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			level_set_type(l, y, x, l->tile[y][x].type);
+			level_set_creature(l, y, x, l->tile[y][x].creature);
+		}
+	}
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			l->wallmask[y][x] = 0;
+			for (int i = 0; i < 8; i++) {
+				int ny = y + level_neighbours[i].y;
+				int nx = x + level_neighbours[i].x;
+
+				if (! level_contains(ny, nx)
+				    || T_WALL == l->tile[ny][nx].type)
+					l->wallmask[y][x] |= 1 << i;
+			}
+		}
+	}
+}
+
+/*
+ * Load the level description in filename over l. On error return -1 and
+ * set errstrp to the reason, it is up to the caller to report it as this
+ * may run on the thread generating a level in the background.
+ */
+int
+level_load(struct level *l, const char *filename, const char **errstrp)
 {
 	struct coordinate	 size, position = {0, 0};
 	size_t			 linez;
@@ -183,9 +285,6 @@ level_load(struct level *l, const char *filename)
 				goto closeclean;
 			}
 			y = position.y;
-			linez = 0;
-			linelen = 0;
-			line = NULL;
 			while (-1 != (linelen = getline(&line, &linez, s))) {
 				if (linelen - 1 != size.x) {
 					errstr = "bad value for size.x";
@@ -197,13 +296,13 @@ level_load(struct level *l, const char *filename)
 
 					lx = x + position.x;
 					if ('#' == line[x]) {
-						l->tile[y][lx].type = T_WALL;
+						level_set_type(l, y, lx, T_WALL);
 					} else if ('<' == line[x]) {
-						l->tile[y][lx].type = T_UPSTAIR;
+						level_set_type(l, y, lx, T_UPSTAIR);
 					} else if ('>' == line[x]) {
-						l->tile[y][lx].type = T_DOWNSTAIR;
+						level_set_type(l, y, lx, T_DOWNSTAIR);
 					} else if (' ' == line[x]) {
-						l->tile[y][lx].type = T_EMPTY;
+						level_set_type(l, y, lx, T_EMPTY);
 					}
 				}
 				y += 1;
@@ -218,15 +317,15 @@ level_load(struct level *l, const char *filename)
 	fclose(s);
 	free(line);
 	line = NULL;
-	return;
+	level_label(l);
+	return(0);
 closeclean:
 	fclose(s);
 	free(line);
 	line = NULL;
 clean:
-	ui_cleanup();
-	fprintf(stderr, "%s: %s\n", filename, errstr);
-	exit(EXIT_FAILURE);
+	*errstrp = errstr;
+	return(-1);
 }
 
 void
@@ -244,7 +343,8 @@ coordinate_copy(struct coordinate *dest, struct coordinate *src)
 }
 
 int
-level_add_stairs(struct level *l, bool build_upstair, bool build_downstair)
+level_add_stairs(struct level *l, bool build_upstair, bool build_downstair,
+    struct rng *r)
 {
 	struct coordinate upstair, downstair;
 	struct coordinate existing_upstair, existing_downstair;
@@ -276,13 +376,13 @@ level_add_stairs(struct level *l, bool build_upstair, bool build_downstair)
 		log_debug("Try to add stairs (%i)\n", count);
 		count += 1;
 		if (-1 == existing_upstair.y)
-			upstair.y = rng_rand_uniform(MAXROWS);
+			upstair.y = rng_rand_uniform_r(r, MAXROWS);
 		if (-1 == existing_upstair.x)
-			upstair.x = rng_rand_uniform(MAXCOLS);
+			upstair.x = rng_rand_uniform_r(r, MAXCOLS);
 		if (-1 == existing_downstair.y)
-			downstair.y = rng_rand_uniform(MAXROWS);
+			downstair.y = rng_rand_uniform_r(r, MAXROWS);
 		if (-1 == existing_downstair.x)
-			downstair.x = rng_rand_uniform(MAXCOLS);
+			downstair.x = rng_rand_uniform_r(r, MAXCOLS);
 		/* Ensure stairs are not too close */
 		if (abs((upstair.y + upstair.x) - (downstair.y + downstair.x)) < 50)
 			continue;
@@ -290,12 +390,14 @@ level_add_stairs(struct level *l, bool build_upstair, bool build_downstair)
 			continue;
 		if (! tile_is_empty(&(l->tile[downstair.y][downstair.x])))
 			continue;
-		if (false == are_coordinate_reachable(l, &upstair, &downstair))
+		if (false == level_is_connected(l, &upstair, &downstair))
 			continue;
 		if (build_upstair)
-			l->tile[upstair.y][upstair.x].type = T_UPSTAIR;
+			level_set_type(l, upstair.y, upstair.x,
+			    T_UPSTAIR);
 		if (build_downstair)
-			l->tile[downstair.y][downstair.x].type = T_DOWNSTAIR;
+			level_set_type(l, downstair.y, downstair.x,
+			    T_DOWNSTAIR);
 		break;
 	} while (count < 50);
 	if (count == 50) {
@@ -321,3 +423,150 @@ level_find(struct level *l, enum tile_type tile, struct coordinate *coord)
 	coord->x = -1;
 	return(-1);
 }
+
+static uint16_t
+label_find(uint16_t *parent, uint16_t label)
+{
+	while (parent[label] != label) {
+		parent[label] = parent[parent[label]];
+		label = parent[label];
+	}
+	return(label);
+}
+
+static void
+label_union(uint16_t *parent, uint16_t a, uint16_t b)
+{
+	a = label_find(parent, a);
+	b = label_find(parent, b);
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+/*
+ * Label the connected components of the level, walls excepted, with the
+ * two-pass algorithm: provisional labels are given and merged with a
+ * union-find in the first pass, then made final and consecutive in the
+ * second one. Two cells share a label if a creature can walk from one to
+ * the other, regardless of other creatures.
+ */
+void
+level_label(struct level *l)
+{
+	uint16_t parent[MAXROWS * MAXCOLS + 1];
+	uint16_t final[MAXROWS * MAXCOLS + 1];
+	uint16_t next;
+
+	next = 1;
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			uint16_t label = 0;
+
+			l->component[y][x] = 0;
+			if (tile_is_wall(&(l->tile[y][x])))
+				continue;
+			/* Only look at the neighbours already labelled */
+			for (int i = 0; i < 4; i++) {
+				static const int dy[4] = {0, -1, -1, -1};
+				static const int dx[4] = {-1, -1, 0, 1};
+				int ny, nx;
+
+				ny = y + dy[i];
+				nx = x + dx[i];
+				if (ny < 0 || nx < 0 || nx >= MAXCOLS)
+					continue;
+				if (0 == l->component[ny][nx])
+					continue;
+				if (0 == label)
+					label = l->component[ny][nx];
+				else
+					label_union(parent, label,
+					    l->component[ny][nx]);
+			}
+			if (0 == label) {
+				label = next;
+				parent[label] = label;
+				next += 1;
+			}
+			l->component[y][x] = label;
+		}
+	}
+	l->componentsz = 0;
+	for (uint16_t label = 1; label < next; label++) {
+		if (label_find(parent, label) == label) {
+			l->componentsz += 1;
+			final[label] = l->componentsz;
+		}
+	}
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			if (0 == l->component[y][x])
+				continue;
+			l->component[y][x] =
+			    final[label_find(parent, l->component[y][x])];
+		}
+	}
+}
+
+/*
+ * Tell if a creature could walk from a to b. Only valid after the level
+ * has been labelled, which cave_gen() and level_load() do.
+ */
+bool
+level_is_connected(struct level *l, struct coordinate *a, struct coordinate *b)
+{
+	uint16_t label;
+
+	label = l->component[a->y][a->x];
+	if (0 == label)
+		return(false);
+	return(label == l->component[b->y][b->x]);
+}
+
+/*
+ * Turn into walls every pocket unreachable from the stairs already present
+ * on the level, or from its largest cave if there is none, so that nothing
+ * can be placed where the player can't go.
+ */
+void
+level_cull_pockets(struct level *l)
+{
+	struct coordinate stair;
+	uint16_t size[MAXROWS * MAXCOLS + 1];
+	uint16_t keep;
+
+	keep = 0;
+	if (0 == level_find(l, T_UPSTAIR, &stair)
+	    || 0 == level_find(l, T_DOWNSTAIR, &stair))
+		keep = l->component[stair.y][stair.x];
+	if (0 == keep) {
+		uint16_t largest = 0;
+
+		for (uint16_t label = 0; label <= l->componentsz; label++)
+			size[label] = 0;
+		for (int y = 0; y < MAXROWS; y++)
+			for (int x = 0; x < MAXCOLS; x++)
+				size[l->component[y][x]] += 1;
+		for (uint16_t label = 1; label <= l->componentsz; label++) {
+			if (size[label] > largest) {
+				largest = size[label];
+				keep = label;
+			}
+		}
+	}
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			if (0 == l->component[y][x])
+				continue;
+			if (keep == l->component[y][x]) {
+				l->component[y][x] = 1;
+			} else {
+				level_set_type(l, y, x, T_WALL);
+				l->component[y][x] = 0;
+			}
+		}
+	}
+	l->componentsz = 0 == keep ? 0 : 1;
+}
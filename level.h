@@ -20,6 +20,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+struct creatures;
+struct rng;
+
 #define MAXROWS 22
 #define MAXCOLS 80
 
@@ -35,7 +38,33 @@ enum tile_type {
 
 struct tile {
 	enum tile_type	 type;
-	struct creature	*creature;
+	uint32_t	 creature;	/* Handle, CREATURE_NONE if none */
+};
+
+/*
+ * One bit per cell, each row of the level packed into two 64 bits words.
+ */
+#define BITBOARD_WORDS	2
+#define BITBOARD_LAST	((UINT64_C(1) << (MAXCOLS - 64)) - 1)
+
+#if MAXCOLS <= 64 || MAXCOLS > 64 * BITBOARD_WORDS
+#error "MAXCOLS doesn't fit in a bitboard row"
+#endif
+
+struct bitboard {
+	uint64_t	 row[MAXROWS][BITBOARD_WORDS];
+};
+
+#define BITBOARD_TEST(b, y, x) \
+	(((b)->row[(y)][(x) >> 6] >> ((x) & 63)) & 1)
+#define BITBOARD_SET(b, y, x) \
+	((b)->row[(y)][(x) >> 6] |= UINT64_C(1) << ((x) & 63))
+#define BITBOARD_UNSET(b, y, x) \
+	((b)->row[(y)][(x) >> 6] &= ~(UINT64_C(1) << ((x) & 63)))
+
+struct coordinate {
+	int x;
+	int y;
 };
 
 enum level_type {
@@ -49,25 +78,84 @@ struct level {
 	enum level_type	 type;
 	bool		 visited;
 	char		*entrymessage;
+	/* Table the creatures standing on the level belong to */
+	struct creatures *creatures;
 	struct tile	 tile[MAXROWS][MAXCOLS];
+	/* Views of tile kept in sync by the tile mutators */
+	struct bitboard	 wall;
+	struct bitboard	 walkable;
+	struct bitboard	 occupied;
+	struct bitboard	 dirty;		/* Changed since last drawn */
+	/* Walls around each cell, one bit per neighbour as in level_neighbours */
+	uint8_t		 wallmask[MAXROWS][MAXCOLS];
+	/* Field of view of the player, see fov.c */
+	struct bitboard	 visible;
+	struct bitboard	 remembered;	/* Seen once, drawn from memory */
+	struct coordinate viewer;	/* -1 if there is none */
+	bool		 viewstale;	/* A wall in range changed */
+	/* Connected component of each cell, 0 for walls */
+	uint16_t	 component[MAXROWS][MAXCOLS];
+	uint16_t	 componentsz;
 };
 
-struct coordinate {
-	int x;
-	int y;
-};
+/*
+ * The eight neighbours of a cell clockwise from the north, the bit of each
+ * in the wall mask being its position in this table. Cells off the level
+ * count as walls.
+ */
+#define NEIGHBOUR_N	0x01
+#define NEIGHBOUR_NE	0x02
+#define NEIGHBOUR_E	0x04
+#define NEIGHBOUR_SE	0x08
+#define NEIGHBOUR_S	0x10
+#define NEIGHBOUR_SW	0x20
+#define NEIGHBOUR_W	0x40
+#define NEIGHBOUR_NW	0x80
+
+extern const struct coordinate level_neighbours[8];
 
 bool tile_is_empty(struct tile *);
 bool tile_is_wall(struct tile *);
 void tile_print(struct tile *, int, int);
 
+void bitboard_clear(struct bitboard *);
+void bitboard_dilate(struct bitboard *, const struct bitboard *);
+bool bitboard_flood(struct bitboard *, const struct bitboard *,
+    int, int);
+int bitboard_count(const struct bitboard *);
+int bitboard_count_both(const struct bitboard *, const struct bitboard *);
+
 void level_init(struct level *);
-void level_load(struct level *, const char *);
+void level_set_type(struct level *, int, int, enum tile_type);
+void level_set_creature(struct level *, int, int, uint32_t);
+void level_sync(struct level *);
+int level_load(struct level *, const char *, const char **);
 void level_draw(struct level *);
-int level_add_stairs(struct level *, bool, bool);
+int level_add_stairs(struct level *, bool, bool, struct rng *);
 int level_find(struct level *, enum tile_type, struct coordinate *);
+void level_label(struct level *);
+bool level_is_connected(struct level *, struct coordinate *,
+    struct coordinate *);
+void level_cull_pockets(struct level *);
+
+/* Options of the cellular automaton generating caves */
+struct cave_params {
+	int	 steps;		/* Number of smoothing passes */
+	int	 ratio;		/* Percentage of walls at initialization */
+	int	 birth;		/* Walls around an empty cell to become a wall */
+	int	 survival;	/* Walls around a wall needed to remain one */
+};
+
+extern const struct cave_params cave_defaults;
+
+void cave_gen(struct level *, const struct cave_params *, struct rng *);
+
+/* Radius of the field of view of the player */
+#define FOV_RADIUS 10
 
-void cave_gen(struct level *);
+void fov_compute(struct bitboard *, const struct bitboard *, int, int, int);
+bool fov_update(struct level *, int, int);
+bool fov_sees_viewer(struct level *, int, int, int);
 
 void coordinate_copy(struct coordinate *, struct coordinate *);
 void coordinate_init(struct coordinate *);
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2018 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "ui.h"
+
+static FILE *debug;
+
+void
+log_open(const char *path)
+{
+	if (NULL == (debug = fopen(path, "w+"))) {
+		fprintf(stderr, "Too bad\n");
+	}
+}
+
+void
+log_debug(const char *str, ...)
+{
+	va_list ap;
+
+	if (NULL != debug) {
+		va_start(ap, str);
+		vfprintf(debug, str, ap);
+		va_end(ap);
+		fflush(debug);
+	}
+}
+
+void
+log_close(void)
+{
+	(void)fclose(debug);
+	debug = NULL;
+}
+
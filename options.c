@@ -20,6 +20,7 @@
 
 struct optionsmap optionsmap[] = {
 	{"colors", false},
+	{"box walls", false},
 };
 
 struct keybindingsmap keybindingsmap[] = {
@@ -44,6 +45,7 @@ struct keybindingsmap keybindingsmap[] = {
 	{"rest",		'.'},
 	{"upstair",		'<'},
 	{"downstair",		'>'},
+	{"travel to downstair",	'_'},
 	{"look here",   	':'},
 	{"look elsewhere",	';'},
 	{"show help menu",	'?'},
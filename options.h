@@ -21,6 +21,7 @@
 
 enum option {
 	O_COLORS,
+	O_BOXWALLS,
 	O__MAX,
 };
 
@@ -52,6 +53,7 @@ enum keybinding {
 	K_REST,
 	K_UPSTAIR,
 	K_DOWNSTAIR,
+	K_TRAVEL,
 	K_LOOKHERE,
 	K_LOOKELSEWHERE,
 	K_HELPMENU,
@@ -63,6 +63,7 @@ main(int argc, char *argv[])
 	struct coordinate start, end;
 	struct coordqueue cq;
 	char *levelpath;
+	const char *errstr;
 	int ch, found;
 
 	while ((ch = getopt(argc, argv, "")) != -1) {
@@ -81,7 +82,10 @@ main(int argc, char *argv[])
 
 	ui_init();
 	level_init(&l);
-	level_load(&l, levelpath);
+	if (-1 == level_load(&l, levelpath, &errstr)) {
+		ui_cleanup();
+		errx(1, "%s: %s", levelpath, errstr);
+	}
 	if (L_STATIC != l.type) {
 		warnx("only entirely static levels are allowed");
 		ui_cleanup();
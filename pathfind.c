@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "level.h"
 #include "pathfind.h"
@@ -148,92 +149,348 @@ coordqueue_free(struct coordqueue *cq)
 	cq->queuez = -1;
 }
 
-bool
-are_coordinate_reachable(struct level *l, struct coordinate *start, struct coordinate *end)
+#define BFS_INDEX(y, x)	(((y) + 1) * BFS_COLS + (x) + 1)
+
+/* Offsets of the eight neighbours of a cell in the padded BFS grid */
+static const int bfs_neighbours[8] = {
+	-BFS_COLS - 1, -BFS_COLS, -BFS_COLS + 1,
+	-1, 1,
+	BFS_COLS - 1, BFS_COLS, BFS_COLS + 1,
+};
+
+static void
+bfs_init_border(struct bfs *b)
 {
-	struct coordqueue cq;
-	int found;
-
-	/*
-	 * Starting from (start->y, start->x) explore every adjacent cell and
-	 * count the number of steps required to reach it.
-	 * Do not insert a new position if the tested cell is out of
-	 * the screen, is a wall or other unreachable type, or if a shorter path
-	 * a already been found.
-	 */
-	coordqueue_init(&cq);
-	coordqueue_add(&cq, start->y, start->x, 0);
-
-	for (int elem = 0; elem < coordqueue_size(&cq); elem++) {
-		int y, x, counter;
-
-		y = cq.queue[elem].y;
-		x = cq.queue[elem].x;
-		if (-1 == y || -1 == x) {
-			continue;
-		}
-		counter = cq.counter[elem];
-		counter += 1;
-		if (0 != y
-		    && tile_is_empty(&(l->tile[y - 1][x]))
-		    && -1 == coordqueue_exists(&cq, y - 1, x, counter)) {
-			coordqueue_add(&cq, y - 1, x, counter);
-		}
-		if (0 != y && MAXCOLS != x
-		    && tile_is_empty(&(l->tile[y - 1][x + 1]))
-		    && -1 == coordqueue_exists(&cq, y - 1, x + 1, counter)) {
-			coordqueue_add(&cq, y - 1, x + 1, counter);
-		}
-		if (MAXCOLS != x
-		    && tile_is_empty(&(l->tile[y][x + 1]))
-		    && -1 == coordqueue_exists(&cq, y, x + 1, counter)) {
-			coordqueue_add(&cq, y, x + 1, counter);
-		}
-		if (MAXROWS != y && MAXCOLS != x
-		    && tile_is_empty(&(l->tile[y + 1][x + 1]))
-		    && -1 == coordqueue_exists(&cq, y + 1, x + 1, counter)) {
-			coordqueue_add(&cq, y + 1, x + 1, counter);
-		}
-		if (MAXROWS != y
-		    && tile_is_empty(&(l->tile[y + 1][x]))
-		    && -1 == coordqueue_exists(&cq, y + 1, x, counter)) {
-			coordqueue_add(&cq, y + 1, x, counter);
-		}
-		if (MAXROWS != y && 0 != x
-		    && tile_is_empty(&(l->tile[y + 1][x - 1]))
-		    && -1 == coordqueue_exists(&cq, y + 1, x - 1, counter)) {
-			coordqueue_add(&cq, y + 1, x - 1, counter);
-		}
-		if (0 != x
-		    && tile_is_empty(&(l->tile[y][x - 1]))
-		    && -1 == coordqueue_exists(&cq, y, x - 1, counter)) {
-			coordqueue_add(&cq, y, x - 1, counter);
-		}
-		if (0 != y && 0 != x
-		    && tile_is_empty(&(l->tile[y - 1][x - 1]))
-		    && -1 == coordqueue_exists(&cq, y - 1, x - 1, counter)) {
-			coordqueue_add(&cq, y - 1, x - 1, counter);
+	for (int x = 0; x < BFS_COLS; x++) {
+		b->dist[x] = BFS_BLOCKED;
+		b->dist[(BFS_ROWS - 1) * BFS_COLS + x] = BFS_BLOCKED;
+	}
+	for (int y = 0; y < MAXROWS; y++) {
+		b->dist[BFS_INDEX(y, -1)] = BFS_BLOCKED;
+		b->dist[BFS_INDEX(y, MAXCOLS)] = BFS_BLOCKED;
+	}
+	b->head = 0;
+	b->len = 0;
+}
+
+/*
+ * Prepare a BFS over the level: every empty tile is left to be explored
+ * while walls, creatures and the border around the level are blocked.
+ */
+void
+bfs_init(struct bfs *b, struct level *l)
+{
+	bfs_init_border(b);
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			if (tile_is_empty(&(l->tile[y][x])))
+				b->dist[BFS_INDEX(y, x)] = BFS_UNSEEN;
+			else
+				b->dist[BFS_INDEX(y, x)] = BFS_BLOCKED;
 		}
 	}
-	/* Find the target destination in the coordqueue */
-	found = -1;
-	for (int elem = cq.queuez - 1; elem >= 0; elem--) {
-		int y, x;
+}
 
-		y = cq.queue[elem].y;
-		x = cq.queue[elem].x;
-		if (-1 == cq.queue[elem].y) {
-			continue;
+/*
+ * Same as bfs_init() but only walls are blocked, creatures are ignored.
+ */
+void
+bfs_init_terrain(struct bfs *b, struct level *l)
+{
+	bfs_init_border(b);
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			if (tile_is_wall(&(l->tile[y][x])))
+				b->dist[BFS_INDEX(y, x)] = BFS_BLOCKED;
+			else
+				b->dist[BFS_INDEX(y, x)] = BFS_UNSEEN;
 		}
-		if (y == end->y && x == end->x) {
-			found = elem;
-			break;
+	}
+}
+
+/*
+ * Start the exploration from (y, x). The source itself does not have to be
+ * empty, which allows to start from the cell of a creature.
+ */
+int
+bfs_add_source(struct bfs *b, int y, int x)
+{
+	size_t tail;
+
+	if (y < 0 || y >= MAXROWS || x < 0 || x >= MAXCOLS)
+		return(-1);
+	if (0 == b->dist[BFS_INDEX(y, x)])
+		return(0);
+	b->dist[BFS_INDEX(y, x)] = 0;
+	tail = (b->head + b->len) % (MAXROWS * MAXCOLS);
+	b->frontier[tail] = BFS_INDEX(y, x);
+	b->len += 1;
+	return(0);
+}
+
+/*
+ * Explore the level from the sources in breadth first order, recording the
+ * number of steps required to reach each cell. Every cell enters the
+ * frontier at most once so it can never overflow.
+ * Stop early as soon as target is reached if it is not NULL and return its
+ * distance, or -1 if it can't be reached.
+ */
+int
+bfs_run(struct bfs *b, struct coordinate *target)
+{
+	int goal = -1;
+
+	if (NULL != target) {
+		if (target->y < 0 || target->y >= MAXROWS
+		    || target->x < 0 || target->x >= MAXCOLS)
+			return(-1);
+		goal = BFS_INDEX(target->y, target->x);
+		if (0 == b->dist[goal])
+			return(0);
+	}
+	while (b->len > 0) {
+		int cell, dist;
+
+		cell = b->frontier[b->head];
+		b->head = (b->head + 1) % (MAXROWS * MAXCOLS);
+		b->len -= 1;
+		dist = b->dist[cell] + 1;
+		for (int i = 0; i < 8; i++) {
+			int n, tail;
+
+			n = cell + bfs_neighbours[i];
+			if (BFS_UNSEEN != b->dist[n])
+				continue;
+			b->dist[n] = dist;
+			if (n == goal)
+				return(dist);
+			tail = (b->head + b->len) % (MAXROWS * MAXCOLS);
+			b->frontier[tail] = n;
+			b->len += 1;
 		}
 	}
-	coordqueue_free(&cq);
-	if (-1 == found) {
+	if (-1 == goal)
+		return(-1);
+	return(bfs_distance(b, target->y, target->x));
+}
+
+/*
+ * Number of steps between the closest source and (y, x) or -1 if the cell
+ * was not reached.
+ */
+int
+bfs_distance(struct bfs *b, int y, int x)
+{
+	int dist;
+
+	if (y < 0 || y >= MAXROWS || x < 0 || x >= MAXCOLS)
+		return(-1);
+	dist = b->dist[BFS_INDEX(y, x)];
+	if (dist < 0)
+		return(-1);
+	return(dist);
+}
+
+/*
+ * Flood fill the empty tiles of the level from start, a whole bitboard at a
+ * time, until end is reached.
+ */
+bool
+are_coordinate_reachable(struct level *l, struct coordinate *start, struct coordinate *end)
+{
+	struct bitboard reach, empty;
+
+	if (start->y < 0 || start->y >= MAXROWS
+	    || start->x < 0 || start->x >= MAXCOLS)
+		return(false);
+	if (end->y < 0 || end->y >= MAXROWS
+	    || end->x < 0 || end->x >= MAXCOLS)
 		return(false);
+	for (int y = 0; y < MAXROWS; y++)
+		for (int w = 0; w < BITBOARD_WORDS; w++)
+			empty.row[y][w] =
+			    l->walkable.row[y][w] & ~l->occupied.row[y][w];
+	bitboard_clear(&reach);
+	BITBOARD_SET(&reach, start->y, start->x);
+	return(bitboard_flood(&reach, &empty, end->y, end->x));
+}
+
+static int
+astar_heuristic(int cell, int goal)
+{
+	int dy, dx;
+
+	dy = abs(cell / BFS_COLS - goal / BFS_COLS);
+	dx = abs(cell % BFS_COLS - goal % BFS_COLS);
+	/* Octile distance */
+	if (dy > dx)
+		return(ASTAR_COST_STRAIGHT * dy
+		    + (ASTAR_COST_DIAGONAL - ASTAR_COST_STRAIGHT) * dx);
+	return(ASTAR_COST_STRAIGHT * dx
+	    + (ASTAR_COST_DIAGONAL - ASTAR_COST_STRAIGHT) * dy);
+}
+
+/* Order the open set on f, then prefer the cells closest to the goal */
+static bool
+astar_before(struct astar *a, int c1, int c2)
+{
+	if (a->f[c1] != a->f[c2])
+		return(a->f[c1] < a->f[c2]);
+	return(a->g[c1] > a->g[c2]);
+}
+
+static void
+astar_heap_set(struct astar *a, size_t i, int cell)
+{
+	a->heap[i] = cell;
+	a->pos[cell] = i;
+}
+
+static void
+astar_heap_up(struct astar *a, size_t i)
+{
+	int cell;
+
+	cell = a->heap[i];
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+
+		if (! astar_before(a, cell, a->heap[parent]))
+			break;
+		astar_heap_set(a, i, a->heap[parent]);
+		i = parent;
 	}
-	return(true);
+	astar_heap_set(a, i, cell);
 }
 
+static int
+astar_heap_pop(struct astar *a)
+{
+	size_t i;
+	int top, cell;
+
+	top = a->heap[0];
+	a->heaplen -= 1;
+	if (0 == a->heaplen)
+		return(top);
+	cell = a->heap[a->heaplen];
+	i = 0;
+	for (;;) {
+		size_t child = 2 * i + 1;
+
+		if (child >= a->heaplen)
+			break;
+		if (child + 1 < a->heaplen
+		    && astar_before(a, a->heap[child + 1], a->heap[child]))
+			child += 1;
+		if (! astar_before(a, a->heap[child], cell))
+			break;
+		astar_heap_set(a, i, a->heap[child]);
+		i = child;
+	}
+	astar_heap_set(a, i, cell);
+	return(top);
+}
+
+void
+astar_init(struct astar *a)
+{
+	(void)memset(a, 0, sizeof(*a));
+}
+
+/*
+ * Search the shortest path between start and end with the A* algorithm,
+ * moving in the same eight directions as the creatures. The end cell may be
+ * occupied by a creature, which allows to chase it.
+ * The steps following start are written in path, up to pathz of them.
+ * Return the length of the whole path, which may be larger than pathz, or
+ * -1 if end can't be reached.
+ */
+int
+astar_path(struct astar *a, struct level *l, struct coordinate *start,
+    struct coordinate *end, struct coordinate *path, size_t pathz)
+{
+	uint32_t open, closed;
+	int source, goal, len;
+
+	if (start->y < 0 || start->y >= MAXROWS
+	    || start->x < 0 || start->x >= MAXCOLS)
+		return(-1);
+	if (end->y < 0 || end->y >= MAXROWS
+	    || end->x < 0 || end->x >= MAXCOLS)
+		return(-1);
+	if (tile_is_wall(&(l->tile[end->y][end->x])))
+		return(-1);
+	/* Each query uses two marks: one for open cells, one for closed */
+	if (a->generation >= UINT32_MAX - 2) {
+		(void)memset(a->mark, 0, sizeof(a->mark));
+		a->generation = 0;
+	}
+	a->generation += 2;
+	open = a->generation;
+	closed = a->generation + 1;
+	source = BFS_INDEX(start->y, start->x);
+	goal = BFS_INDEX(end->y, end->x);
+	a->mark[source] = open;
+	a->g[source] = 0;
+	a->f[source] = astar_heuristic(source, goal);
+	a->parent[source] = source;
+	a->heaplen = 1;
+	astar_heap_set(a, 0, source);
+	while (a->heaplen > 0) {
+		int cell;
+
+		cell = astar_heap_pop(a);
+		if (cell == goal)
+			break;
+		a->mark[cell] = closed;
+		for (int i = 0; i < 8; i++) {
+			int n, y, x, g;
+
+			n = cell + bfs_neighbours[i];
+			if (closed == a->mark[n])
+				continue;
+			y = n / BFS_COLS - 1;
+			x = n % BFS_COLS - 1;
+			if (y < 0 || y >= MAXROWS || x < 0 || x >= MAXCOLS)
+				continue;
+			if (n != goal && ! tile_is_empty(&(l->tile[y][x])))
+				continue;
+			g = a->g[cell];
+			if (i == 1 || i == 3 || i == 4 || i == 6)
+				g += ASTAR_COST_STRAIGHT;
+			else
+				g += ASTAR_COST_DIAGONAL;
+			if (open == a->mark[n]) {
+				if (g >= a->g[n])
+					continue;
+				a->g[n] = g;
+				a->f[n] = g + astar_heuristic(n, goal);
+				a->parent[n] = cell;
+				astar_heap_up(a, a->pos[n]);
+				continue;
+			}
+			a->mark[n] = open;
+			a->g[n] = g;
+			a->f[n] = g + astar_heuristic(n, goal);
+			a->parent[n] = cell;
+			astar_heap_set(a, a->heaplen, n);
+			a->heaplen += 1;
+			astar_heap_up(a, a->heaplen - 1);
+		}
+	}
+	if (open != a->mark[goal])
+		return(-1);
+	/* Walk back from the goal to count the steps, then fill the path */
+	len = 0;
+	for (int cell = goal; cell != source; cell = a->parent[cell])
+		len += 1;
+	for (int cell = goal, i = len - 1; cell != source;
+	    cell = a->parent[cell], i--) {
+		if ((size_t)i >= pathz)
+			continue;
+		path[i].y = cell / BFS_COLS - 1;
+		path[i].x = cell % BFS_COLS - 1;
+	}
+	return(len);
+}
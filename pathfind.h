@@ -18,9 +18,27 @@
 #define PATHFIND_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct coordinate;
 
+/*
+ * The BFS grid is the level surrounded by a one cell border of blocked
+ * cells, so that neighbours can be visited without bounds checks.
+ */
+#define BFS_ROWS	(MAXROWS + 2)
+#define BFS_COLS	(MAXCOLS + 2)
+#define BFS_CELLS	(BFS_ROWS * BFS_COLS)
+#define BFS_UNSEEN	-1
+#define BFS_BLOCKED	-2
+
+struct bfs {
+	int16_t		 dist[BFS_CELLS];
+	uint16_t	 frontier[MAXROWS * MAXCOLS];
+	size_t		 head;
+	size_t		 len;
+};
+
 struct coordqueue {
 	size_t			 queuez;
 	struct coordinate	*queue;
@@ -36,6 +54,33 @@ int coordqueue_grow(struct coordqueue *);
 int coordqueue_add(struct coordqueue *, int, int, int);
 int coordqueue_init(struct coordqueue *);
 void coordqueue_free(struct coordqueue *);
+void bfs_init(struct bfs *, struct level *);
+void bfs_init_terrain(struct bfs *, struct level *);
+int bfs_add_source(struct bfs *, int, int);
+int bfs_run(struct bfs *, struct coordinate *);
+int bfs_distance(struct bfs *, int, int);
+/*
+ * Scratch storage of an A* query. Cells are tagged with the generation of
+ * the query that last touched them so the arrays don't need to be cleared
+ * between two queries.
+ */
+#define ASTAR_COST_STRAIGHT	10
+#define ASTAR_COST_DIAGONAL	14
+
+struct astar {
+	uint32_t	 generation;
+	uint32_t	 mark[BFS_CELLS];
+	int32_t		 g[BFS_CELLS];
+	int32_t		 f[BFS_CELLS];
+	uint16_t	 parent[BFS_CELLS];
+	uint16_t	 pos[BFS_CELLS];
+	uint16_t	 heap[MAXROWS * MAXCOLS];
+	size_t		 heaplen;
+};
+
+void astar_init(struct astar *);
+int astar_path(struct astar *, struct level *, struct coordinate *,
+    struct coordinate *, struct coordinate *, size_t);
 bool are_coordinate_reachable(struct level *, struct coordinate *, struct coordinate *);
 
 #endif
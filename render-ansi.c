@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * Backend writing a frame as escape sequences of ANSI terminals, built in
+ * a buffer and sent with a single write. The cursor is only moved when a
+ * cell does not follow the one drawn before, and the colours only set when
+ * they change, so a frame costs little more than its changed cells.
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "level.h"
+#include "render.h"
+#include "ui.h"
+
+/* Moving the cursor, setting the colours and an UTF-8 character per cell */
+#define ANSI_BUFSZ	(MAXROWS * MAXCOLS * 24 + 64)
+
+struct ansi {
+	int	 fd;
+	int	 top;		/* Row of the screen of the first one */
+	int	 cury;		/* Cursor, -1 if not known */
+	int	 curx;
+	int	 pair;		/* Colours in use, -1 if not known */
+	size_t	 len;
+	char	 buf[ANSI_BUFSZ];
+};
+
+/* Colours of each pair, as set by ui_reset_colors */
+static const char *sgr[PAIR__MAX] = {
+	"\033[0m",
+	"\033[0;37;40m",
+	"\033[0;30;47m",
+	"\033[0;31;47m",
+	"\033[0;30;46m",
+	"\033[0;32;40m",
+};
+
+static void
+ansi_puts(struct ansi *a, const char *s)
+{
+	size_t sz = strlen(s);
+
+	(void)memcpy(a->buf + a->len, s, sz);
+	a->len += sz;
+}
+
+static void
+ansi_goto(struct ansi *a, int y, int x)
+{
+	a->len += snprintf(a->buf + a->len, sizeof(a->buf) - a->len,
+	    "\033[%d;%dH", a->top + y + 1, x + 1);
+}
+
+/*
+ * Move the cursor to the cell, forward on the same row if it can.
+ */
+static void
+ansi_move(struct ansi *a, int y, int x)
+{
+	if (y == a->cury && x == a->curx)
+		return;
+	if (y != a->cury || x < a->curx)
+		ansi_goto(a, y, x);
+	else if (x == a->curx + 1)
+		ansi_puts(a, "\033[C");
+	else
+		a->len += snprintf(a->buf + a->len, sizeof(a->buf) - a->len,
+		    "\033[%dC", x - a->curx);
+}
+
+static void
+ansi_put(struct renderer *r, int y, int x, glyph g)
+{
+	struct ansi	*a = r->data;
+	int		 c = GLYPH_CHAR(g);
+
+	ansi_move(a, y, x);
+	if (GLYPH_PAIR(g) != a->pair) {
+		a->pair = GLYPH_PAIR(g);
+		ansi_puts(a, sgr[a->pair]);
+	}
+	if (c >= GL_VLINE)
+		ansi_puts(a, render_line_utf8(g));
+	else
+		a->buf[a->len++] = c;
+	a->cury = y;
+	a->curx = x + 1;
+	/* Past the last column the terminal may or may not wrap */
+	if (MAXCOLS == a->curx)
+		a->cury = -1;
+}
+
+static void
+ansi_flush(struct renderer *r)
+{
+	struct ansi	*a = r->data;
+	size_t		 off = 0;
+	ssize_t		 n;
+
+	while (off < a->len) {
+		if (-1 == (n = write(a->fd, a->buf + off, a->len - off))) {
+			if (EINTR == errno)
+				continue;
+			log_debug("ansi: write: %s\n", strerror(errno));
+			break;
+		}
+		off += n;
+	}
+	a->len = 0;
+}
+
+static void
+ansi_free(struct renderer *r)
+{
+	struct ansi *a = r->data;
+
+	ansi_puts(a, sgr[0]);
+	ansi_goto(a, MAXROWS, 0);
+	ansi_puts(a, "\033[?25h");
+	ansi_flush(r);
+	free(a);
+}
+
+/*
+ * Draw on the terminal open on fd, the level starting on the given row.
+ * The screen is cleared by the first frame.
+ */
+int
+render_ansi_init(struct renderer *r, int fd, int top)
+{
+	struct ansi *a;
+
+	if (NULL == (a = malloc(sizeof(*a))))
+		return(-1);
+	render_init(r);
+	r->put = ansi_put;
+	r->flush = ansi_flush;
+	r->free = ansi_free;
+	r->data = a;
+	a->fd = fd;
+	a->top = top;
+	a->cury = -1;
+	a->curx = -1;
+	a->pair = 0;
+	a->len = 0;
+	ansi_puts(a, "\033[0m\033[?25l\033[H\033[2J");
+	return(0);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * Backend keeping the frame in memory, for the programs checking what
+ * would be on screen without a terminal.
+ */
+
+#include "config.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "level.h"
+#include "render.h"
+
+struct memory {
+	glyph	 cell[MAXROWS][MAXCOLS];
+};
+
+static void
+memory_put(struct renderer *r, int y, int x, glyph g)
+{
+	struct memory *m = r->data;
+
+	m->cell[y][x] = g;
+}
+
+static void
+memory_flush(struct renderer *r)
+{
+	(void)r;
+}
+
+static void
+memory_free(struct renderer *r)
+{
+	free(r->data);
+}
+
+int
+render_memory_init(struct renderer *r)
+{
+	struct memory *m;
+
+	if (NULL == (m = malloc(sizeof(*m))))
+		return(-1);
+	render_init(r);
+	r->put = memory_put;
+	r->flush = memory_flush;
+	r->free = memory_free;
+	r->data = m;
+	for (int y = 0; y < MAXROWS; y++)
+		for (int x = 0; x < MAXCOLS; x++)
+			m->cell[y][x] = ' ';
+	return(0);
+}
+
+glyph
+render_memory_get(struct renderer *r, int y, int x)
+{
+	struct memory *m = r->data;
+
+	return(m->cell[y][x]);
+}
+
+/*
+ * Print the frame as text, without its colours.
+ */
+void
+render_memory_print(struct renderer *r, FILE *f)
+{
+	struct memory *m = r->data;
+
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			glyph g = m->cell[y][x];
+
+			if (GLYPH_CHAR(g) >= GL_VLINE)
+				fputs(render_line_utf8(g), f);
+			else
+				fputc(GLYPH_CHAR(g), f);
+		}
+		fputc('\n', f);
+	}
+}
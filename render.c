@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "creature.h"
+#include "level.h"
+#include "options.h"
+#include "render.h"
+
+/*
+ * Glyphs of the tiles, the creatures and the walls, built in advance for
+ * the current options so that drawing a cell is a lookup. Walls are found
+ * by the mask of the walls around them.
+ */
+static glyph tileglyph[T__MAX];
+static glyph raceglyph[R__MAX + 1];
+static glyph wallglyph[256];
+
+/* Every renderer between render_init and render_free */
+static struct renderer *renderers;
+
+/*
+ * Line drawing character joining a wall to its neighbours in the
+ * directions N, E, S and W, indexed by these four bits in this order.
+ */
+static const glyph walllines[16] = {
+	'#',		GL_VLINE,	GL_HLINE,	GL_LLCORNER,
+	GL_VLINE,	GL_VLINE,	GL_ULCORNER,	GL_LTEE,
+	GL_HLINE,	GL_LRCORNER,	GL_HLINE,	GL_BTEE,
+	GL_URCORNER,	GL_RTEE,	GL_TTEE,	GL_PLUS,
+};
+
+static const char *lineutf8[GL__MAX - GL_VLINE] = {
+	"\xe2\x94\x82",	/* GL_VLINE */
+	"\xe2\x94\x80",	/* GL_HLINE */
+	"\xe2\x94\x8c",	/* GL_ULCORNER */
+	"\xe2\x94\x90",	/* GL_URCORNER */
+	"\xe2\x94\x94",	/* GL_LLCORNER */
+	"\xe2\x94\x98",	/* GL_LRCORNER */
+	"\xe2\x94\x9c",	/* GL_LTEE */
+	"\xe2\x94\xa4",	/* GL_RTEE */
+	"\xe2\x94\xac",	/* GL_TTEE */
+	"\xe2\x94\xb4",	/* GL_BTEE */
+	"\xe2\x94\xbc",	/* GL_PLUS */
+};
+
+/*
+ * A wall only joins a neighbouring wall if the edge between them is seen
+ * from an open cell, so rock is drawn as its outline. A wall only seen
+ * through a corner joins all of them, as the outline turns there.
+ */
+static glyph
+render_wall_glyph(int mask)
+{
+	static const int sides[4][3] = {
+		{ NEIGHBOUR_N, NEIGHBOUR_NW, NEIGHBOUR_NE },
+		{ NEIGHBOUR_E, NEIGHBOUR_NE, NEIGHBOUR_SE },
+		{ NEIGHBOUR_S, NEIGHBOUR_SE, NEIGHBOUR_SW },
+		{ NEIGHBOUR_W, NEIGHBOUR_SW, NEIGHBOUR_NW },
+	};
+	int lines = 0;
+
+	if (0xff == mask)
+		return(' ');
+	for (int i = 0; i < 4; i++) {
+		if (0 == (mask & sides[i][0]))
+			continue;
+		if (0 == (mask & sides[i][1]) || 0 == (mask & sides[i][2]))
+			lines |= 1 << i;
+	}
+	if (0 == lines)
+		for (int i = 0; i < 4; i++)
+			if (mask & sides[i][0])
+				lines |= 1 << i;
+	return(walllines[lines]);
+}
+
+/*
+ * Build the glyphs for the current options. The renderers must then be
+ * invalidated as what they show may be out of date.
+ */
+void
+render_build_glyphs(void)
+{
+	int pair[PAIR__MAX];
+
+	for (int i = 0; i < PAIR__MAX; i++)
+		pair[i] = optionsmap[O_COLORS].value ? i : 0;
+	for (int i = 0; i < T__MAX; i++)
+		tileglyph[i] = GLYPH('?', pair[3]);
+	tileglyph[T_EMPTY] = ' ';
+	tileglyph[T_WALL] = '#';
+	tileglyph[T_UPSTAIR] = '<';
+	tileglyph[T_DOWNSTAIR] = '>';
+	tileglyph[T_GOBLIN] = GLYPH('g', pair[5]);
+	tileglyph[T_HUMAN] = GLYPH('@', pair[2]);
+	/* Visual error meaning I forgot to assign a glyph */
+	for (int i = 0; i <= R__MAX; i++)
+		raceglyph[i] = GLYPH('X', pair[3]);
+	raceglyph[R_GOBLIN] = tileglyph[T_GOBLIN];
+	raceglyph[R_HUMAN] = tileglyph[T_HUMAN];
+	for (int i = 0; i < 256; i++) {
+		if (optionsmap[O_BOXWALLS].value)
+			wallglyph[i] = render_wall_glyph(i);
+		else
+			wallglyph[i] = tileglyph[T_WALL];
+	}
+}
+
+/*
+ * Give the UTF-8 encoding of a line drawing character.
+ */
+const char *
+render_line_utf8(glyph g)
+{
+	int c = GLYPH_CHAR(g);
+
+	if (c < GL_VLINE || c >= GL__MAX)
+		return("?");
+	return(lineutf8[c - GL_VLINE]);
+}
+
+static uint64_t
+pacer_now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return((uint64_t)t.tv_sec * 1000000000 + t.tv_nsec);
+}
+
+/*
+ * Pace at fps frames a second, or draw all of them if it is 0.
+ */
+void
+pacer_init(struct pacer *p, int fps)
+{
+	p->interval = fps > 0 ? 1000000000 / fps : 0;
+	p->last = 0;
+	p->urged = true;
+	p->drawn = 0;
+	p->skipped = 0;
+}
+
+void
+pacer_urge(struct pacer *p)
+{
+	p->urged = true;
+}
+
+/*
+ * Tell if a frame must be drawn now, counting it as drawn if so.
+ */
+bool
+pacer_due(struct pacer *p)
+{
+	uint64_t t = 0;
+
+	if (0 != p->interval) {
+		t = pacer_now();
+		if (! p->urged && t - p->last < p->interval) {
+			p->skipped += 1;
+			return(false);
+		}
+	}
+	p->last = t;
+	p->urged = false;
+	p->drawn += 1;
+	return(true);
+}
+
+/*
+ * Called by the backends once their functions are set. Nothing is known
+ * to be on screen yet.
+ */
+void
+render_init(struct renderer *r)
+{
+	r->data = NULL;
+	r->next = renderers;
+	renderers = r;
+	render_invalidate(r);
+}
+
+/*
+ * Forget what was drawn, the next frame draws every cell again.
+ */
+void
+render_invalidate(struct renderer *r)
+{
+	r->level = NULL;
+	bitboard_clear(&(r->dirty));
+	for (int y = 0; y < MAXROWS; y++)
+		for (int x = 0; x < MAXCOLS; x++)
+			r->shadow[y][x] = GLYPH_NONE;
+}
+
+/*
+ * Mask of the walls around a wall as the player knows them: the walls
+ * never seen do not join it. The edges of the level always do.
+ */
+static uint8_t
+render_wall_mask(struct level *l, int y, int x)
+{
+	uint8_t mask = l->wallmask[y][x];
+
+	if (-1 == l->viewer.y)
+		return(mask);
+	for (int i = 0; i < 8; i++) {
+		int ny = y + level_neighbours[i].y;
+		int nx = x + level_neighbours[i].x;
+
+		if (ny < 0 || ny >= MAXROWS || nx < 0 || nx >= MAXCOLS)
+			continue;
+		if (! BITBOARD_TEST(&(l->remembered), ny, nx))
+			mask &= ~(1 << i);
+	}
+	return(mask);
+}
+
+/*
+ * Glyph of a cell as the player sees it. Cells out of view are drawn from
+ * memory, without their creatures. A level without viewer is seen whole.
+ */
+static glyph
+render_tile_glyph(struct level *l, int y, int x)
+{
+	struct tile	*t = &(l->tile[y][x]);
+	bool		 seen;
+
+	seen = -1 == l->viewer.y || BITBOARD_TEST(&(l->visible), y, x);
+	if (! seen && ! BITBOARD_TEST(&(l->remembered), y, x))
+		return(' ');
+	if (seen && CREATURE_NONE != t->creature && NULL != l->creatures)
+		return(raceglyph[l->creatures->race[
+		    CREATURE_INDEX(t->creature)]]);
+	if (T_WALL == t->type)
+		return(wallglyph[render_wall_mask(l, y, x)]);
+	return(tileglyph[t->type]);
+}
+
+/*
+ * Hand the cells of the level marked dirty by the tile mutators to every
+ * renderer which drew it last, so that none of them misses a change.
+ */
+static void
+render_collect(struct level *l)
+{
+	for (struct renderer *r = renderers; NULL != r; r = r->next) {
+		if (l != r->level)
+			continue;
+		for (int y = 0; y < MAXROWS; y++)
+			for (int w = 0; w < BITBOARD_WORDS; w++)
+				r->dirty.row[y][w] |= l->dirty.row[y][w];
+	}
+	bitboard_clear(&(l->dirty));
+}
+
+/*
+ * Draw a frame of the level. Only the cells changed since the last frame
+ * of this renderer are looked at, unless the level is not the one it drew
+ * last, and only those whose glyph changed are given to the backend.
+ */
+void
+render_level(struct renderer *r, struct level *l)
+{
+	bool	 all;
+	glyph	 g;
+
+	render_collect(l);
+	/*
+	 * Another level. A buffer reused for another level keeps its address
+	 * but level_init marked all of its cells dirty.
+	 */
+	all = l != r->level;
+	r->level = l;
+	for (int y = 0; y < MAXROWS; ++y) {
+		if (! all && 0 == (r->dirty.row[y][0] | r->dirty.row[y][1]))
+			continue;
+		for (int x = 0; x < MAXCOLS; ++x) {
+			if (! all && ! BITBOARD_TEST(&(r->dirty), y, x))
+				continue;
+			g = render_tile_glyph(l, y, x);
+			if (g == r->shadow[y][x])
+				continue;
+			r->shadow[y][x] = g;
+			r->put(r, y, x, g);
+		}
+	}
+	bitboard_clear(&(r->dirty));
+	r->flush(r);
+}
+
+/*
+ * Draw a frame of the level if one is due, the first one of a level always
+ * is. Return true if it was drawn.
+ */
+bool
+render_paced(struct renderer *r, struct pacer *p, struct level *l)
+{
+	if (l != r->level)
+		pacer_urge(p);
+	if (! pacer_due(p))
+		return(false);
+	render_level(r, l);
+	return(true);
+}
+
+void
+render_free(struct renderer *r)
+{
+	struct renderer **link;
+
+	for (link = &renderers; NULL != *link; link = &((*link)->next)) {
+		if (r == *link) {
+			*link = r->next;
+			break;
+		}
+	}
+	if (NULL != r->free)
+		r->free(r);
+	r->data = NULL;
+	r->level = NULL;
+}
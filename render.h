@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef RENDER_H__
+#define RENDER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "level.h"
+
+/*
+ * What a cell of the screen shows: a character and the colour pair it is
+ * drawn with, numbered as in ui_reset_colors. Characters above 127 stand
+ * for the line drawing characters, which each backend draws its own way.
+ */
+typedef uint16_t glyph;
+
+#define GLYPH(c, pair)	((glyph)((c) | (pair) << 8))
+#define GLYPH_CHAR(g)	((g) & 0xff)
+#define GLYPH_PAIR(g)	((g) >> 8)
+/* Never drawn, so that a cell holding it is always drawn again */
+#define GLYPH_NONE	((glyph)0xffff)
+
+#define PAIR__MAX	6
+
+enum glyph_line {
+	GL_VLINE = 128,
+	GL_HLINE,
+	GL_ULCORNER,
+	GL_URCORNER,
+	GL_LLCORNER,
+	GL_LRCORNER,
+	GL_LTEE,
+	GL_RTEE,
+	GL_TTEE,
+	GL_BTEE,
+	GL_PLUS,
+	GL__MAX,
+};
+
+/*
+ * Frames of a level drawn on a backend. Only the cells changed since the
+ * last frame are given to put, then flush ends the frame. Several
+ * renderers may draw the same level: the dirty cells of the level are
+ * handed to each of them before being cleared.
+ */
+struct renderer {
+	void		(*put)(struct renderer *, int, int, glyph);
+	void		(*flush)(struct renderer *);
+	void		(*free)(struct renderer *);
+	void		*data;		/* Of the backend */
+	struct level	*level;		/* Drawn in the last frame */
+	struct bitboard	 dirty;		/* Changed since then */
+	struct renderer	*next;		/* Of the renderers in use */
+	glyph		 shadow[MAXROWS][MAXCOLS];
+};
+
+/*
+ * While the game plays by itself, during a run or a replay, frames are
+ * drawn at most fps times a second and the others skipped: the level is
+ * only drawn as it is when a frame is due. A frame is always drawn when it
+ * is urged, for a new level or a message.
+ */
+struct pacer {
+	uint64_t	 interval;	/* Nanoseconds, 0 to draw every frame */
+	uint64_t	 last;		/* Time of the last frame drawn */
+	bool		 urged;
+	uint64_t	 drawn;
+	uint64_t	 skipped;
+};
+
+void pacer_init(struct pacer *, int);
+void pacer_urge(struct pacer *);
+bool pacer_due(struct pacer *);
+
+void render_build_glyphs(void);
+const char *render_line_utf8(glyph);
+void render_init(struct renderer *);
+void render_invalidate(struct renderer *);
+void render_level(struct renderer *, struct level *);
+bool render_paced(struct renderer *, struct pacer *, struct level *);
+void render_free(struct renderer *);
+
+/* Escape sequences written to a file descriptor, one write per frame */
+int render_ansi_init(struct renderer *, int, int);
+
+/* Frame kept in memory, to be compared or printed */
+int render_memory_init(struct renderer *);
+glyph render_memory_get(struct renderer *, int, int);
+void render_memory_print(struct renderer *, FILE *);
+
+#endif
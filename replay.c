@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "options.h"
+#include "replay.h"
+#include "ui.h"
+
+static void
+replay_init(struct replay *r, FILE *f)
+{
+	r->f = f;
+	r->line = NULL;
+	r->linez = 0;
+	r->name = NULL;
+	r->value = NULL;
+	r->pending = false;
+	r->turns = 0;
+	r->checked = 0;
+}
+
+int
+replay_record(struct replay *r, const char *path, uint32_t seed,
+    int32_t depth)
+{
+	FILE *f;
+
+	if (NULL == (f = fopen(path, "w")))
+		return(-1);
+	replay_init(r, f);
+	fprintf(f, "seed: %" PRIu32 "\n", seed);
+	fprintf(f, "levels: %" PRIi32 "\n", depth);
+	return(0);
+}
+
+void
+replay_record_key(struct replay *r, int key)
+{
+	if (key >= 0 && key < K__MAX)
+		fprintf(r->f, "key: %s\n", keybindingsmap[key].name);
+}
+
+void
+replay_record_turn(struct replay *r, uint64_t hash)
+{
+	r->turns += 1;
+	fprintf(r->f, "hash: %016" PRIx64 "\n", hash);
+}
+
+/*
+ * Read the next line and split it in its name and value, or return -1 at
+ * the end of the file or on a malformed line.
+ */
+static int
+replay_next(struct replay *r)
+{
+	ssize_t	 linelen;
+	char	*linep;
+
+	if (r->pending) {
+		r->pending = false;
+		return(0);
+	}
+	if (-1 == (linelen = getline(&(r->line), &(r->linez), r->f)))
+		return(-1);
+	if (linelen > 0 && '\n' == r->line[linelen - 1])
+		r->line[linelen - 1] = '\0';
+	linep = r->line;
+	r->name = strsep(&linep, ":");
+	if (NULL == linep) {
+		log_debug("bad replay line -- %s\n", r->line);
+		return(-1);
+	}
+	while (' ' == linep[0] || '\t' == linep[0])
+		linep++;
+	r->value = linep;
+	return(0);
+}
+
+int
+replay_open(struct replay *r, const char *path, uint32_t *seed,
+    int32_t *depth)
+{
+	FILE		*f;
+	const char	*errstr = NULL;
+
+	if (NULL == (f = fopen(path, "r")))
+		return(-1);
+	replay_init(r, f);
+	while (0 == replay_next(r)) {
+		if (0 == strcmp(r->name, "seed"))
+			*seed = strtonum(r->value, 0, UINT32_MAX, &errstr);
+		else if (0 == strcmp(r->name, "levels"))
+			*depth = strtonum(r->value, 2, INT32_MAX, &errstr);
+		else {
+			r->pending = true;
+			return(0);
+		}
+		if (NULL != errstr) {
+			log_debug("bad replay %s -- %s\n", r->name, r->value);
+			break;
+		}
+	}
+	replay_close(r);
+	return(-1);
+}
+
+/*
+ * Give the next key of the player, or K_QUIT once the recording is over.
+ * Hashes of turns not checked are skipped.
+ */
+int
+replay_key(struct replay *r)
+{
+	while (0 == replay_next(r)) {
+		if (0 != strcmp(r->name, "key"))
+			continue;
+		for (int key = 0; key < K__MAX; key++)
+			if (0 == strcmp(keybindingsmap[key].name, r->value))
+				return(key);
+		log_debug("bad replay key -- %s\n", r->value);
+		break;
+	}
+	return(K_QUIT);
+}
+
+/*
+ * Compare the state of the game after a turn with the recording, if it
+ * holds a hash for this turn. Return -1 if they differ and 1 once the
+ * recording is over.
+ */
+int
+replay_check_turn(struct replay *r, uint64_t hash)
+{
+	uint64_t expected;
+
+	r->turns += 1;
+	if (-1 == replay_next(r))
+		return(1);
+	if (0 != strcmp(r->name, "hash")) {
+		r->pending = true;
+		return(0);
+	}
+	expected = strtoull(r->value, NULL, 16);
+	r->checked += 1;
+	if (expected != hash)
+		return(-1);
+	/* Stop right there rather than let a run go on */
+	if (-1 == replay_next(r))
+		return(1);
+	r->pending = true;
+	return(0);
+}
+
+void
+replay_close(struct replay *r)
+{
+	if (NULL != r->f)
+		(void)fclose(r->f);
+	free(r->line);
+	replay_init(r, NULL);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REPLAY_H__
+#define REPLAY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A game is entirely given by its seed, its depth and the keys of the
+ * player, so that is all a recording holds, along with a hash of the state
+ * of the game after each turn to catch any divergence when it is played
+ * again. Each line is a "name: value" pair as in the configuration file.
+ */
+struct replay {
+	FILE		*f;
+	char		*line;
+	size_t		 linez;
+	char		*name;		/* Of the last line read */
+	char		*value;
+	bool		 pending;	/* Last line to be read again */
+	uint64_t	 turns;
+	uint64_t	 checked;
+};
+
+int replay_record(struct replay *, const char *, uint32_t, int32_t);
+void replay_record_key(struct replay *, int);
+void replay_record_turn(struct replay *, uint64_t);
+int replay_open(struct replay *, const char *, uint32_t *, int32_t *);
+int replay_key(struct replay *);
+int replay_check_turn(struct replay *, uint64_t);
+void replay_close(struct replay *);
+
+#endif
@@ -7,14 +7,23 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include "rng.h"
 
-static uint32_t rng_storage[4096];
-static uint32_t rng_counter = 4095;
-static uint32_t rng_seed = 0;
-static uint32_t rng_carry = 0;
+/* The instance behind the non reentrant functions */
+static struct rng rng_global = {
+	.counter = RNG_LAG - 1,
+	.seed = 0,
+	.carry = 0,
+};
+
+struct rng *
+rng_default(void)
+{
+	return(&rng_global);
+}
 
 /*
  * This is interesting in cases such as save file or tests.
@@ -22,13 +31,13 @@ static uint32_t rng_carry = 0;
 void
 rng_set_seed(uint32_t seed)
 {
-	rng_seed = seed;
+	rng_global.seed = seed;
 }
 
 uint32_t
 rng_get_seed(void)
 {
-	return(rng_seed);
+	return(rng_global.seed);
 }
 
 /*
@@ -38,46 +47,189 @@ rng_get_seed(void)
  * Section Parameters_in_common_use
  * Row Numerical Recipes
  */
-void
-rng_init(void)
+static void
+rng_fill(struct rng *r)
 {
 	uint32_t i, seed;
 
-	if (rng_seed == 0) {
+	seed = r->seed;
+	r->carry = seed;
+	for (i = 0; i < RNG_LAG; i++) {
+		r->storage[i] = seed;
+		seed = seed * 1664525 + 1013904223;
+	}
+}
+
+/*
+ * Pick a random seed if none was given. The position in the array is kept
+ * as it is, for compatibility with existing seeds.
+ */
+void
+rng_init(void)
+{
+	if (rng_global.seed == 0) {
 #if HAVE_ARC4RANDOM
-		rng_seed = arc4random();
+		rng_global.seed = arc4random();
 #else
 		srandom(time(NULL));
-		rng_seed = random();
+		rng_global.seed = random();
 #endif
 	}
-	seed = rng_seed;
-	rng_carry = seed;
-	for (i = 0; i < (sizeof(rng_storage) / sizeof(uint32_t)); i++) {
-		rng_storage[i] = seed;
-		seed = seed * 1664525 + 1013904223;
-	}
+	rng_fill(&rng_global);
+}
+
+uint32_t
+rng_rand(void)
+{
+	return(rng_rand_r(&rng_global));
+}
+
+uint32_t
+rng_rand_uniform(uint32_t bound)
+{
+	return(rng_rand_uniform_r(&rng_global, bound));
+}
+
+/*
+ * Initialize an independent generator. Unlike rng_init() the seed is used
+ * as it is, even 0.
+ */
+void
+rng_init_r(struct rng *r, uint32_t seed)
+{
+	r->seed = seed;
+	r->counter = RNG_LAG - 1;
+	rng_fill(r);
+}
+
+/*
+ * The clone gives the same numbers as the original from now on.
+ */
+void
+rng_clone(struct rng *dst, const struct rng *src)
+{
+	(void)memcpy(dst, src, sizeof(*dst));
 }
 
 /*
  * Simple RNG from Marsaglia RNGs 2003 post.
  */
 uint32_t
-rng_rand(void)
+rng_rand_r(struct rng *r)
 {
 	uint64_t t;
 	uint32_t x;
 
-	rng_counter = (rng_counter + 1) & 4095;
-	t = 18782LL * rng_storage[rng_counter] + rng_carry;
-	rng_carry = (t >> 32);
-	x = (uint32_t)(t + rng_carry);
-	if (x < rng_carry) {
+	r->counter = (r->counter + 1) & (RNG_LAG - 1);
+	t = 18782LL * r->storage[r->counter] + r->carry;
+	r->carry = (t >> 32);
+	x = (uint32_t)(t + r->carry);
+	if (x < r->carry) {
 		x += 1;
-		rng_carry += 1;
+		r->carry += 1;
+	}
+	r->storage[r->counter] = 0xfffffffe - x;
+	return(r->storage[r->counter]);
+}
+
+/*
+ * Fill buf with the next n numbers of the generator, the same ones that n
+ * calls to rng_rand_r() would give. The state stays in registers and the
+ * lag table is refilled one contiguous run at a time, without wrapping the
+ * index for every number. The carry chains each number to the previous one
+ * so the loop can't be vectorized further.
+ */
+void
+rng_fill_r(struct rng *r, uint32_t *buf, size_t n)
+{
+	uint32_t carry, i;
+
+	carry = r->carry;
+	i = r->counter;
+	while (n > 0) {
+		uint32_t *storage;
+		size_t run;
+
+		i = (i + 1) & (RNG_LAG - 1);
+		run = RNG_LAG - i;
+		if (run > n)
+			run = n;
+		storage = &(r->storage[i]);
+		for (size_t j = 0; j < run; j++) {
+			uint64_t t;
+			uint32_t x;
+
+			t = 18782LL * storage[j] + carry;
+			carry = (t >> 32);
+			x = (uint32_t)(t + carry);
+			if (x < carry) {
+				x += 1;
+				carry += 1;
+			}
+			storage[j] = 0xfffffffe - x;
+			buf[j] = storage[j];
+		}
+		buf += run;
+		n -= run;
+		i += run - 1;
+	}
+	r->carry = carry;
+	r->counter = i;
+}
+
+/*
+ * Fill buf with n numbers lower than bound with the multiply-shift method
+ * of Daniel Lemire, "Fast Random Integer Generation in an Interval", which
+ * only needs a division for the rare rejected numbers.
+ */
+void
+rng_fill_uniform_r(struct rng *r, uint32_t *buf, size_t n, uint32_t bound)
+{
+	uint32_t threshold;
+
+	if (bound < 2) {
+		for (size_t j = 0; j < n; j++)
+			buf[j] = 0;
+		return;
+	}
+	threshold = -bound % bound;
+	rng_fill_r(r, buf, n);
+	for (size_t j = 0; j < n; j++) {
+		uint64_t m;
+
+		m = (uint64_t)buf[j] * bound;
+		while ((uint32_t)m < threshold)
+			m = (uint64_t)rng_rand_r(r) * bound;
+		buf[j] = m >> 32;
+	}
+}
+
+/*
+ * Set each of the first nbits bits of mask with a probability of
+ * percent / 100, up to 2^-32. The remaining bits of the last word are
+ * cleared.
+ */
+void
+rng_fill_bits_r(struct rng *r, uint64_t *mask, size_t nbits, uint32_t percent)
+{
+	uint32_t buf[64];
+	uint64_t threshold, word;
+
+	if (percent > 100)
+		percent = 100;
+	threshold = ((uint64_t)percent << 32) / 100;
+	for (size_t w = 0; w * 64 < nbits; w++) {
+		size_t n;
+
+		n = nbits - w * 64;
+		if (n > 64)
+			n = 64;
+		rng_fill_r(r, buf, n);
+		word = 0;
+		for (size_t j = 0; j < n; j++)
+			word |= (uint64_t)(buf[j] < threshold) << j;
+		mask[w] = word;
 	}
-	rng_storage[rng_counter] = 0xfffffffe - x;
-	return(rng_storage[rng_counter]);
 }
 
 /*
@@ -86,7 +238,7 @@ rng_rand(void)
  * ISC license
  */
 uint32_t
-rng_rand_uniform(uint32_t bound)
+rng_rand_uniform_r(struct rng *rng, uint32_t bound)
 {
 	uint32_t r, min;
 
@@ -94,10 +246,80 @@ rng_rand_uniform(uint32_t bound)
 		return(0);
 	min = -bound % bound;
 	for (;;) {
-		r = rng_rand();
+		r = rng_rand_r(rng);
 		if (r >= min)
 			break;
 	}
 	return (r % bound);
 }
 
+/*
+ * Finalizer of SplitMix64, see http://xorshift.di.unimi.it/splitmix64.c
+ */
+static uint64_t
+rng_mix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+	return(z ^ (z >> 31));
+}
+
+static uint64_t
+rng_derive64(uint32_t seed, enum rng_domain domain, uint32_t index)
+{
+	uint64_t z;
+
+	z = (uint64_t)domain << 32 | index;
+	z = rng_mix(z + UINT64_C(0x9e3779b97f4a7c15));
+	return(rng_mix(z ^ seed));
+}
+
+/*
+ * Seed of the stream number index of a domain. It only depends on its
+ * arguments, so a level or a creature gets the same numbers whatever was
+ * generated before it and whichever thread generates it.
+ */
+uint32_t
+rng_derive(uint32_t seed, enum rng_domain domain, uint32_t index)
+{
+	return((uint32_t)(rng_derive64(seed, domain, index) >> 32));
+}
+
+void
+rng_init_stream(struct rng *r, uint32_t seed, enum rng_domain domain,
+    uint32_t index)
+{
+	rng_init_r(r, rng_derive(seed, domain, index));
+}
+
+void
+rng_stream_init(struct rng_stream *s, uint32_t seed, enum rng_domain domain,
+    uint32_t index)
+{
+	s->key = rng_derive64(seed, domain, index);
+	s->counter = 0;
+}
+
+uint32_t
+rng_stream_rand(struct rng_stream *s)
+{
+	s->counter += 1;
+	return((uint32_t)(rng_mix(s->key
+	    + s->counter * UINT64_C(0x9e3779b97f4a7c15)) >> 32));
+}
+
+uint32_t
+rng_stream_rand_uniform(struct rng_stream *s, uint32_t bound)
+{
+	uint32_t r, min;
+
+	if (bound < 2)
+		return(0);
+	min = -bound % bound;
+	for (;;) {
+		r = rng_stream_rand(s);
+		if (r >= min)
+			break;
+	}
+	return (r % bound);
+}
@@ -2,15 +2,58 @@
  * Public domain - 2018 Tristan Le Guern <tleguern@bouledef.eu>
  */
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifndef RNG_H__
 #define RNG_H__
 
+#define RNG_LAG 4096
+
+struct rng {
+	uint32_t storage[RNG_LAG];
+	uint32_t counter;
+	uint32_t seed;
+	uint32_t carry;
+};
+
 void rng_set_seed(uint32_t);
 uint32_t rng_get_seed(void);
 void rng_init(void);
 uint32_t rng_rand(void);
 uint32_t rng_rand_uniform(uint32_t);
 
+/*
+ * Lightweight counter-based generator: the n-th number only depends on the
+ * key and n, so streams never interfere with each other.
+ */
+struct rng_stream {
+	uint64_t key;
+	uint64_t counter;
+};
+
+/* Independent families of streams derived from the seed of a game */
+enum rng_domain {
+	RNG_LEVEL,
+	RNG_CREATURE,
+	RNG_POPULATE,
+	RNG_INPUT,
+};
+
+struct rng *rng_default(void);
+void rng_init_r(struct rng *, uint32_t);
+void rng_clone(struct rng *, const struct rng *);
+uint32_t rng_rand_r(struct rng *);
+uint32_t rng_rand_uniform_r(struct rng *, uint32_t);
+void rng_fill_r(struct rng *, uint32_t *, size_t);
+void rng_fill_uniform_r(struct rng *, uint32_t *, size_t, uint32_t);
+void rng_fill_bits_r(struct rng *, uint64_t *, size_t, uint32_t);
+
+uint32_t rng_derive(uint32_t, enum rng_domain, uint32_t);
+void rng_init_stream(struct rng *, uint32_t, enum rng_domain, uint32_t);
+void rng_stream_init(struct rng_stream *, uint32_t, enum rng_domain,
+    uint32_t);
+uint32_t rng_stream_rand(struct rng_stream *);
+uint32_t rng_stream_rand_uniform(struct rng_stream *, uint32_t);
+
 #endif
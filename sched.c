@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "sched.h"
+
+/* Number of ids on the first growth */
+#define SCHED_MINCAPACITY 64
+
+void
+sched_init(struct sched *s, struct arena *a)
+{
+	(void)memset(s, 0, sizeof(*s));
+	s->arena = a;
+}
+
+#define SCHED_GROW(s, field, newcap) do {				\
+	void *p = arena_calloc((s)->arena, (newcap), sizeof(*(s)->field));\
+	if (NULL == p)							\
+		return(-1);						\
+	if (0 != (s)->capacity)						\
+		(void)memcpy(p, (s)->field,				\
+		    (s)->capacity * sizeof(*(s)->field));		\
+	(s)->field = p;							\
+} while (0)
+
+/*
+ * Make room for the ids up to id. As for the creature table, the previous
+ * arrays are left in the arena.
+ */
+static int
+sched_grow(struct sched *s, uint32_t id)
+{
+	uint32_t newcap;
+
+	newcap = 0 == s->capacity ? SCHED_MINCAPACITY : s->capacity;
+	while (newcap <= id) {
+		if (newcap > UINT32_MAX / 2)
+			return(-1);
+		newcap *= 2;
+	}
+	SCHED_GROW(s, heap, newcap);
+	SCHED_GROW(s, pos, newcap);
+	SCHED_GROW(s, time, newcap);
+	SCHED_GROW(s, order, newcap);
+	s->capacity = newcap;
+	return(0);
+}
+
+static bool
+sched_before(struct sched *s, uint32_t id1, uint32_t id2)
+{
+	if (s->time[id1] != s->time[id2])
+		return(s->time[id1] < s->time[id2]);
+	return(s->order[id1] < s->order[id2]);
+}
+
+static void
+sched_heap_set(struct sched *s, uint32_t i, uint32_t id)
+{
+	s->heap[i] = id;
+	s->pos[id] = i + 1;
+}
+
+static void
+sched_heap_up(struct sched *s, uint32_t i)
+{
+	uint32_t id;
+
+	id = s->heap[i];
+	while (i > 0) {
+		uint32_t parent = (i - 1) / 2;
+
+		if (! sched_before(s, id, s->heap[parent]))
+			break;
+		sched_heap_set(s, i, s->heap[parent]);
+		i = parent;
+	}
+	sched_heap_set(s, i, id);
+}
+
+static void
+sched_heap_down(struct sched *s, uint32_t i)
+{
+	uint32_t id;
+
+	id = s->heap[i];
+	for (;;) {
+		uint32_t child = 2 * i + 1;
+
+		if (child >= s->len)
+			break;
+		if (child + 1 < s->len
+		    && sched_before(s, s->heap[child + 1], s->heap[child]))
+			child += 1;
+		if (! sched_before(s, s->heap[child], id))
+			break;
+		sched_heap_set(s, i, s->heap[child]);
+		i = child;
+	}
+	sched_heap_set(s, i, id);
+}
+
+/*
+ * Schedule the event id at the given turn, or move it there if it is
+ * already pending. Events due on the same turn come by increasing order.
+ */
+int
+sched_at(struct sched *s, uint32_t id, uint64_t time, uint32_t order)
+{
+	if (id >= s->capacity && -1 == sched_grow(s, id))
+		return(-1);
+	s->time[id] = time;
+	s->order[id] = order;
+	if (0 == s->pos[id]) {
+		sched_heap_set(s, s->len, id);
+		s->len += 1;
+		sched_heap_up(s, s->len - 1);
+		return(0);
+	}
+	sched_heap_up(s, s->pos[id] - 1);
+	sched_heap_down(s, s->pos[id] - 1);
+	return(0);
+}
+
+void
+sched_cancel(struct sched *s, uint32_t id)
+{
+	uint32_t i, last;
+
+	if (! sched_pending(s, id))
+		return;
+	i = s->pos[id] - 1;
+	s->pos[id] = 0;
+	s->len -= 1;
+	if (i == s->len)
+		return;
+	last = s->heap[s->len];
+	sched_heap_set(s, i, last);
+	sched_heap_up(s, i);
+	sched_heap_down(s, s->pos[last] - 1);
+}
+
+bool
+sched_pending(struct sched *s, uint32_t id)
+{
+	return(id < s->capacity && 0 != s->pos[id]);
+}
+
+/*
+ * Give the next event and its turn without removing it, or -1 if there is
+ * none.
+ */
+int
+sched_peek(struct sched *s, uint32_t *id, uint64_t *time)
+{
+	if (0 == s->len)
+		return(-1);
+	*id = s->heap[0];
+	*time = s->time[*id];
+	return(0);
+}
+
+void
+sched_pop(struct sched *s)
+{
+	if (0 == s->len)
+		return;
+	sched_cancel(s, s->heap[0]);
+}
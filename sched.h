@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SCHED_H__
+#define SCHED_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct arena;
+
+/*
+ * Queue of events ordered on the turn they are due, then on an order given
+ * with each event. Events are named by small integers chosen by the caller
+ * and each of them is scheduled at most once: scheduling it again moves it.
+ */
+struct sched {
+	struct arena	*arena;
+	uint32_t	 capacity;	/* Number of ids */
+	uint32_t	 len;
+	uint32_t	*heap;
+	uint32_t	*pos;		/* Position in heap + 1, 0 if idle */
+	uint64_t	*time;
+	uint32_t	*order;
+};
+
+void sched_init(struct sched *, struct arena *);
+int sched_at(struct sched *, uint32_t, uint64_t, uint32_t);
+void sched_cancel(struct sched *, uint32_t);
+bool sched_pending(struct sched *, uint32_t);
+int sched_peek(struct sched *, uint32_t *, uint64_t *);
+void sched_pop(struct sched *);
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "level.h"
+#include "ui.h"
+#include "creature.h"
+#include "options.h"
+#include "pathfind.h"
+#include "distmap.h"
+#include "world.h"
+#include "session.h"
+
+static int travel_to_downstair(struct creatures *, uint32_t, struct level *,
+    struct astar *);
+static void session_look(struct session *);
+
+void
+session_init(struct session *s, uint32_t seed, int32_t depth)
+{
+	s->running = -1;
+	s->turns = 0;
+	astar_init(&(s->astar));
+	distmaps_init(&(s->dm));
+	log_debug("--- world ---\n");
+	world_init(&(s->w), seed, depth);
+	s->lp = world_first(&(s->w));
+	log_debug("--- creature (hero) ---\n");
+	s->player = world_spawn(&(s->w), R_HUMAN);
+	creature_place_at_stair(&(s->w.creatures), s->player, s->lp, true);
+	world_set_player(&(s->w), s->player);
+	s->inview = 0;
+	s->spotted = false;
+	session_look(s);
+}
+
+/*
+ * Play the key for the player. Return 0 if it took an action, -1 if it
+ * did not and 1 if the game should end.
+ */
+int
+session_key(struct session *s, int key)
+{
+	struct creatures	*cs = &(s->w.creatures);
+	struct world		*w = &(s->w);
+	uint32_t		 p = s->player;
+	uint32_t		 pi = CREATURE_INDEX(p);
+	struct level		*lp = s->lp;
+	int			 noaction;
+
+	switch (key) {
+	case K_RUNLEFT:
+		s->running = K_LEFT;
+		/* FALLTHROUGH */
+	case K_LEFT:
+		noaction = creature_move_left(cs, p, lp);
+		break;
+	case K_RUNDOWN:
+		s->running = K_DOWN;
+		/* FALLTHROUGH */
+	case K_DOWN:
+		noaction = creature_move_down(cs, p, lp);
+		break;
+	case K_RUNUP:
+		s->running = K_UP;
+		/* FALLTHROUGH */
+	case K_UP:
+		noaction = creature_move_up(cs, p, lp);
+		break;
+	case K_RUNRIGHT:
+		s->running = K_RIGHT;
+		/* FALLTHROUGH */
+	case K_RIGHT:
+		noaction = creature_move_right(cs, p, lp);
+		break;
+	case K_RUNUPLEFT:
+		s->running = K_UPLEFT;
+		/* FALLTHROUGH */
+	case K_UPLEFT:
+		noaction = creature_move_upleft(cs, p, lp);
+		break;
+	case K_RUNUPRIGHT:
+		s->running = K_UPRIGHT;
+		/* FALLTHROUGH */
+	case K_UPRIGHT:
+		noaction = creature_move_upright(cs, p, lp);
+		break;
+	case K_RUNDOWNLEFT:
+		s->running = K_DOWNLEFT;
+		/* FALLTHROUGH */
+	case K_DOWNLEFT:
+		noaction = creature_move_downleft(cs, p, lp);
+		break;
+	case K_RUNDOWNRIGHT:
+		s->running = K_DOWNRIGHT;
+		/* FALLTHROUGH */
+	case K_DOWNRIGHT:
+		noaction = creature_move_downright(cs, p, lp);
+		break;
+	case K_UPSTAIR:
+		/* Only change level if the player stands on the stairs */
+		if (0 == w->current
+		    || T_UPSTAIR != lp->tile[cs->y[pi]][cs->x[pi]].type) {
+			noaction = -1;
+			break;
+		}
+		noaction = creature_climb_upstair(cs, p, lp, world_prev(w));
+		s->lp = world_current(w);
+		distmaps_init(&(s->dm));
+		break;
+	case K_DOWNSTAIR:
+		if (T_DOWNSTAIR != lp->tile[cs->y[pi]][cs->x[pi]].type) {
+			noaction = -1;
+			break;
+		}
+		noaction = creature_climb_downstair(cs, p, lp, world_next(w));
+		s->lp = world_current(w);
+		distmaps_init(&(s->dm));
+		break;
+	case K_TRAVEL:
+		s->running = K_TRAVEL;
+		noaction = travel_to_downstair(cs, p, lp, &(s->astar));
+		break;
+	case K_REST:
+		noaction = creature_rest(cs, p);
+		break;
+	case K_LOOKHERE:
+		ui_look(lp, cs->y[pi], cs->x[pi]);
+		ui_draw(lp);
+		noaction = -1;
+		break;
+	case K_LOOKELSEWHERE:
+		ui_look_elsewhere(lp, cs->y[pi], cs->x[pi]);
+		ui_draw(lp);
+		noaction = -1;
+		break;
+	case K_OPTIONMENU:
+		ui_menu_options();
+		ui_draw(lp);
+		noaction = -1;
+		break;
+	case K_HELPMENU:
+		ui_menu_help();
+		ui_draw(lp);
+		noaction = -1;
+		break;
+	case K_QUIT:
+		return(1);
+	default:
+		noaction = -1;
+		break;
+	}
+	if (noaction == -1) {
+		s->running = -1;
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * The player acted: play everything else until its next turn.
+ */
+void
+session_end_turn(struct session *s)
+{
+	struct creatures	*cs = &(s->w.creatures);
+	struct coordinate	 player;
+
+	s->turns += 1;
+	world_spend(&(s->w), s->player);
+	player.y = cs->y[CREATURE_INDEX(s->player)];
+	player.x = cs->x[CREATURE_INDEX(s->player)];
+	/* The creatures act on what the player sees */
+	fov_update(s->lp, player.y, player.x);
+	distmaps_update(&(s->dm), s->lp, &player);
+	world_run(&(s->w), &(s->dm));
+	session_look(s);
+}
+
+/*
+ * Count the creatures in view of the player, a run stops as soon as one
+ * more of them shows up.
+ */
+static void
+session_look(struct session *s)
+{
+	struct creatures	*cs = &(s->w.creatures);
+	uint32_t		 pi = CREATURE_INDEX(s->player);
+	int			 inview;
+
+	fov_update(s->lp, cs->y[pi], cs->x[pi]);
+	inview = bitboard_count_both(&(s->lp->visible),
+	    &(s->lp->occupied)) - 1;
+	s->spotted = inview > s->inview;
+	if (s->spotted)
+		s->running = -1;
+	s->inview = inview;
+}
+
+/*
+ * FNV-1a over everything a turn can change: the creatures and the level of
+ * the player. Two games given the same keys must agree on it at each turn.
+ */
+#define FNV_OFFSET	UINT64_C(0xcbf29ce484222325)
+#define FNV_PRIME	UINT64_C(0x100000001b3)
+
+static uint64_t
+hash_bytes(uint64_t h, const void *buf, size_t bufsz)
+{
+	const uint8_t *p = buf;
+
+	for (size_t i = 0; i < bufsz; i++)
+		h = (h ^ p[i]) * FNV_PRIME;
+	return(h);
+}
+
+uint64_t
+session_hash(struct session *s)
+{
+	struct creatures	*cs = &(s->w.creatures);
+	uint64_t		 h = FNV_OFFSET;
+	size_t			 n = cs->size;
+
+	h = hash_bytes(h, &(s->w.turn), sizeof(s->w.turn));
+	h = hash_bytes(h, &(s->w.current), sizeof(s->w.current));
+	h = hash_bytes(h, cs->x, n * sizeof(*cs->x));
+	h = hash_bytes(h, cs->y, n * sizeof(*cs->y));
+	h = hash_bytes(h, cs->actionpoints, n * sizeof(*cs->actionpoints));
+	h = hash_bytes(h, cs->race, n * sizeof(*cs->race));
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			struct tile *t = &(s->lp->tile[y][x]);
+
+			h = hash_bytes(h, &(t->type), sizeof(t->type));
+			h = hash_bytes(h, &(t->creature), sizeof(t->creature));
+		}
+	}
+	return(h);
+}
+
+void
+session_free(struct session *s)
+{
+	world_free(&(s->w));
+	s->lp = NULL;
+}
+
+/*
+ * Move the creature one step along the shortest path to the downward stairs.
+ */
+static int
+travel_to_downstair(struct creatures *t, uint32_t c, struct level *l,
+    struct astar *a)
+{
+	struct coordinate start, end, step;
+
+	if (-1 == level_find(l, T_DOWNSTAIR, &end))
+		return(-1);
+	start.y = t->y[CREATURE_INDEX(c)];
+	start.x = t->x[CREATURE_INDEX(c)];
+	if (0 >= astar_path(a, l, &start, &end, &step, 1))
+		return(-1);
+	return(creature_move(t, c, l, step.y - start.y, step.x - start.x));
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SESSION_H__
+#define SESSION_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A game being played: the world, the player and the state kept between
+ * two of its actions. It does not depend on any particular frontend.
+ */
+struct session {
+	struct world	 w;
+	struct astar	 astar;
+	struct distmaps	 dm;
+	struct level	*lp;		/* Level of the player */
+	uint32_t	 player;
+	int		 running;	/* Key repeated, -1 if none */
+	uint64_t	 turns;		/* Actions of the player */
+	int		 inview;	/* Creatures seen by the player */
+	bool		 spotted;	/* More of them than the turn before */
+};
+
+void session_init(struct session *, uint32_t, int32_t);
+int session_key(struct session *, int);
+void session_end_turn(struct session *);
+uint64_t session_hash(struct session *);
+void session_free(struct session *);
+
+#endif
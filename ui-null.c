@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2019 Tristan Le Guern <tleguern@bouledef.eu>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * User interface doing nothing, for the programs driving a game without a
+ * terminal. Messages only go to the debug log.
+ */
+
+#include "config.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "ui.h"
+
+void
+ui_alert(const char *message)
+{
+	log_debug("Alert: %s\n", message);
+}
+
+void
+ui_cleanup(void)
+{
+}
+
+void
+ui_draw(struct level *l)
+{
+	(void)l;
+}
+
+void
+ui_frame(struct level *l)
+{
+	(void)l;
+}
+
+void
+ui_init(void)
+{
+}
+
+void
+ui_menu_options(void)
+{
+}
+
+void
+ui_menu_help(void)
+{
+}
+
+void
+ui_message(const char *message, ...)
+{
+	char	buf[256];
+	va_list	ap;
+
+	va_start(ap, message);
+	(void)vsnprintf(buf, sizeof(buf), message, ap);
+	va_end(ap);
+	log_debug("Message: %s\n", buf);
+}
+
+void
+ui_clearmessage(void)
+{
+}
+
+void
+ui_look(struct level *l, int y, int x)
+{
+	(void)l;
+	(void)y;
+	(void)x;
+}
+
+void
+ui_look_elsewhere(struct level *l, int y, int x)
+{
+	(void)l;
+	(void)y;
+	(void)x;
+}
+
+/* There is no keyboard: behave as if it was closed */
+int
+ui_get_input(void)
+{
+	return(EOF);
+}
+
+int
+ui_get_lines(void)
+{
+	return(24);
+}
+
+int
+ui_get_cols(void)
+{
+	return(80);
+}
+
+/* Never wait, the point is to run as fast as possible */
+void
+ui_pause(time_t sec, long nsec)
+{
+	(void)sec;
+	(void)nsec;
+}
+
+void
+ui_set_fps(int fps)
+{
+	(void)fps;
+}
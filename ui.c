@@ -23,95 +23,108 @@
 #include "creature.h"
 #include "level.h"
 #include "options.h"
+#include "render.h"
 #include "ui.h"
 
 static WINDOW *messagewin;
 
+/* The level is drawn on stdscr through the curses backend */
+static struct renderer	 screen;
+static struct pacer	 pacer;
+static chtype		 acslines[GL__MAX - GL_VLINE];
+
 static void ui_reset_colors(void);
 static int  ui_set_message_window(WINDOW *, int);
 
-static chtype ui_tile_type_to_glyph(enum tile_type tile) {
-	chtype glyph;
-
-	switch (tile) {
-		case T_EMPTY:
-			glyph = ' ';
-			break;
-		case T_WALL:
-			glyph = '#';
-			break;
-		case T_UPSTAIR:
-			glyph = '<';
-			break;
-		case T_DOWNSTAIR:
-			glyph = '>';
-			break;
-		case T_GOBLIN:
-			glyph = 'g' | COLOR_PAIR(5);
-			break;
-		case T_HUMAN:
-			glyph = '@' | COLOR_PAIR(2);
-			break;
-		default:
-			glyph = '?' | COLOR_PAIR(3);
-			break;
-	};
+static void
+ui_curses_put(struct renderer *r, int y, int x, glyph g)
+{
+	chtype c = GLYPH_CHAR(g);
 
-	return glyph;
+	(void)r;
+	if (c >= GL_VLINE)
+		c = acslines[c - GL_VLINE];
+	mvaddch(y, x, c | COLOR_PAIR(GLYPH_PAIR(g)));
 }
 
-void
-ui_cleanup(void)
+static void
+ui_curses_flush(struct renderer *r)
 {
-	curs_set(1);
-	endwin();
+	(void)r;
+	wnoutrefresh(stdscr);
 }
 
+/*
+ * The line drawing characters of curses are only known once it is
+ * initialized.
+ */
 static void
-ui_tile_print(struct tile *t, int x, int y) {
-	mvaddch(y, x, ui_tile_type_to_glyph(t->type));
-	if (NULL != t->creature) {
-		int glyph;
-
-		switch (t->creature->race) {
-		case R_GOBLIN:
-			glyph = ui_tile_type_to_glyph(T_GOBLIN);
-			break;
-		case R_HUMAN:
-			glyph = ui_tile_type_to_glyph(T_HUMAN);
-			break;
-		case R__MAX:
-		default:
-			/* Visual error meaning I forgot to assign a glyph */
-			glyph = 'X' | COLOR_PAIR(3);
-			break;
-		}
-		mvaddch(y, x, glyph);
-	}
+ui_curses_init(struct renderer *r)
+{
+	acslines[GL_VLINE - GL_VLINE] = ACS_VLINE;
+	acslines[GL_HLINE - GL_VLINE] = ACS_HLINE;
+	acslines[GL_ULCORNER - GL_VLINE] = ACS_ULCORNER;
+	acslines[GL_URCORNER - GL_VLINE] = ACS_URCORNER;
+	acslines[GL_LLCORNER - GL_VLINE] = ACS_LLCORNER;
+	acslines[GL_LRCORNER - GL_VLINE] = ACS_LRCORNER;
+	acslines[GL_LTEE - GL_VLINE] = ACS_LTEE;
+	acslines[GL_RTEE - GL_VLINE] = ACS_RTEE;
+	acslines[GL_TTEE - GL_VLINE] = ACS_TTEE;
+	acslines[GL_BTEE - GL_VLINE] = ACS_BTEE;
+	acslines[GL_PLUS - GL_VLINE] = ACS_PLUS;
+	r->put = ui_curses_put;
+	r->flush = ui_curses_flush;
+	r->free = NULL;
+	render_init(r);
 }
 
-static void
-ui_level_draw(struct level *l)
+void
+ui_cleanup(void)
 {
-	int x, y;
-
-	for (y = 0; y < MAXROWS; ++y)
-		for (x = 0; x < MAXCOLS; ++x)
-			ui_tile_print(&(l->tile[y][x]), x, y);
+	curs_set(1);
+	endwin();
 }
 
 void
 ui_draw(struct level *l)
 {
-	werase(stdscr);
 	/* draw main screen */
-	ui_level_draw(l);
-	wnoutrefresh(stdscr);
+	render_level(&screen, l);
 	/* draw message screen */
 	wnoutrefresh(messagewin);
 	doupdate();
 }
 
+/*
+ * Draw the level while the game plays by itself, if a frame is due.
+ */
+void
+ui_frame(struct level *l)
+{
+	if (! render_paced(&screen, &pacer, l))
+		return;
+	wnoutrefresh(messagewin);
+	doupdate();
+}
+
+void
+ui_set_fps(int fps)
+{
+	pacer_init(&pacer, fps);
+}
+
+/*
+ * Windows drawn over stdscr hide part of it: have curses compare it all
+ * again with the screen at the next refresh. Nothing is sent for the cells
+ * that were not covered.
+ */
+static void
+ui_popup_close(WINDOW *win)
+{
+	delwin(win);
+	touchwin(stdscr);
+}
+
 void
 ui_init(void)
 {
@@ -124,6 +137,9 @@ ui_init(void)
 	keypad(stdscr, TRUE);
 	intrflush(stdscr, FALSE);
 	meta(stdscr, TRUE);
+	render_build_glyphs();
+	ui_curses_init(&screen);
+	pacer_init(&pacer, 0);
 	if (has_colors() == FALSE)
 		return;
 	ui_reset_colors();
@@ -192,6 +208,12 @@ ui_menu_options(void)
 			switch (choice) {
 			case O_COLORS:
 				ui_reset_colors();
+				render_build_glyphs();
+				render_invalidate(&screen);
+				break;
+			case O_BOXWALLS:
+				render_build_glyphs();
+				render_invalidate(&screen);
 				break;
 			case O__MAX:
 			default:
@@ -200,7 +222,7 @@ ui_menu_options(void)
 			redrawwin(menuwin); /* XXX: Hum */
 		}
 	} while (1);
-	delwin(menuwin);
+	ui_popup_close(menuwin);
 }
 
 void
@@ -240,7 +262,7 @@ ui_menu_help(void)
 		if (exit != -1)
 			break;
 	} while (1);
-	delwin(helpwin);
+	ui_popup_close(helpwin);
 }
 
 void
@@ -254,6 +276,7 @@ ui_message(const char *message, ...)
 	va_end(ap);
 	wclrtoeol(messagewin);
 	wrefresh(messagewin);
+	pacer_urge(&pacer);
 }
 
 void
@@ -261,6 +284,7 @@ ui_clearmessage(void)
 {
 	wclear(messagewin);
 	wrefresh(messagewin);
+	pacer_urge(&pacer);
 }
 
 /* TODO: Change to var args */
@@ -277,7 +301,7 @@ ui_alert(const char *message)
 	mvwaddstr(alertwin, 1, 1, message);
 	wrefresh(alertwin);
 	wgetch(alertwin);
-	delwin(alertwin);
+	ui_popup_close(alertwin);
 }
 
 static int
@@ -330,7 +354,7 @@ ui_look(struct level *l, int y, int x)
 	mvwaddstr(lookwin, 1, 1, message);
 	wrefresh(lookwin);
 	wgetch(lookwin);
-	delwin(lookwin);
+	ui_popup_close(lookwin);
 }
 
 void
@@ -434,34 +458,3 @@ ui_pause(time_t sec, long nsec)
 	t.tv_nsec = nsec;
 	(void)nanosleep(&t, NULL);
 }
-
-static FILE *debug;
-
-void
-log_open(const char *path)
-{
-	if (NULL == (debug = fopen(path, "w+"))) {
-		fprintf(stderr, "Too bad\n");
-	}
-}
-
-void
-log_debug(const char *str, ...)
-{
-	va_list ap;
-
-	if (NULL != debug) {
-		va_start(ap, str);
-		vfprintf(debug, str, ap);
-		va_end(ap);
-		fflush(debug);
-	}
-}
-
-void
-log_close(void)
-{
-	(void)fclose(debug);
-	debug = NULL;
-}
-
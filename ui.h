@@ -24,6 +24,7 @@ struct level;
 void ui_alert(const char *);
 void ui_cleanup(void);
 void ui_draw(struct level *);
+void ui_frame(struct level *);
 void ui_init(void);
 void ui_menu_options(void);
 void ui_menu_help(void);
@@ -35,6 +36,7 @@ int ui_get_input(void);
 int ui_get_lines(void);
 int ui_get_cols(void);
 void ui_pause(time_t, long);
+void ui_set_fps(int);
 
 void log_open(const char *);
 void log_debug(const char *, ...);
@@ -14,13 +14,20 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <err.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "arena.h"
 #include "creature.h"
 #include "level.h"
+#include "pathfind.h"
+#include "distmap.h"
 #include "ui.h"
 #include "rng.h"
 #include "world.h"
@@ -28,86 +35,777 @@
 #define ENTRY_MSG	"You enter the Goblin's Caves"
 #define END_MSG		"Unwelcome to the Hall of the Goblin King"
 
+/* Number of tries to generate a level before forcing its stairs */
+#define MAXATTEMPTS 10
 
+/* Most steps taken by a creature in a coarse tick of a far level */
+#define COARSESTEPS 4
+
+/* Events of the scheduler: the end of each turn, then one per creature */
+#define EV_TURN		0
+#define EV_CREATURE(c)	(CREATURE_INDEX(c) + 1)
+
+/* On a given turn the player acts first and the turn ends last */
+#define ORDER_PLAYER	0
+#define ORDER_TURN	UINT32_MAX
+
+static void world_schedule(struct world *, uint32_t, int64_t);
+
+/*
+ * Place the stairs of a level with no regard for their distance, when a
+ * level does not give any suitable place for them: the downward stairs go
+ * as far as possible from the upward ones.
+ */
+static void
+world_force_stairs(struct level *l, bool build_upstair, bool build_downstair)
+{
+	struct bfs		 b;
+	struct coordinate	 up, down;
+	int			 farthest;
+
+	if (-1 == level_find(l, T_UPSTAIR, &up)
+	    && -1 == level_find(l, T_EMPTY, &up))
+		return;
+	if (build_upstair)
+		level_set_type(l, up.y, up.x, T_UPSTAIR);
+	if (! build_downstair || 0 == level_find(l, T_DOWNSTAIR, &down))
+		return;
+	bfs_init(&b, l);
+	bfs_add_source(&b, up.y, up.x);
+	(void)bfs_run(&b, NULL);
+	farthest = 0;
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++) {
+			if (T_EMPTY != l->tile[y][x].type
+			    || bfs_distance(&b, y, x) <= farthest)
+				continue;
+			farthest = bfs_distance(&b, y, x);
+			down.y = y;
+			down.x = x;
+		}
+	}
+	if (0 != farthest)
+		level_set_type(l, down.y, down.x, T_DOWNSTAIR);
+}
+
+static void
+world_set_message(struct world *w, struct level *l, int32_t index)
+{
+	l->entrymessage = NULL;
+	if (0 == index)
+		l->entrymessage = (char *)ENTRY_MSG;
+	else if (w->levelsz - 1 == index)
+		l->entrymessage = (char *)END_MSG;
+}
+
+/*
+ * Generate the level number index of the world from its own stream derived
+ * from the seed of the world, so it does not depend on the other levels.
+ * Return NULL or the reason the level could not be generated.
+ * The first level is the fixed entrance and the last one the fixed hall
+ * room of the Goblin King, the others are random caves.
+ */
+static const char *
+world_gen_level(struct world *w, struct level *l, int32_t index)
+{
+	struct rng	 r;
+	const char	*file, *errstr;
+	bool		 first, last;
+	int		 attempt;
+
+	first = 0 == index;
+	last = w->levelsz - 1 == index;
+	file = NULL;
+	if (first)
+		file = "misc/entry";
+	else if (last)
+		file = "misc/hall";
+	rng_init_stream(&r, w->seed, RNG_LEVEL, index);
+	for (attempt = 0; attempt < MAXATTEMPTS; attempt++) {
+		level_init(l);
+		cave_gen(l, NULL, &r);
+		if (NULL != file && -1 == level_load(l, file, &errstr))
+			return(errstr);
+		level_cull_pockets(l);
+		if (0 == level_add_stairs(l, ! first, ! last, &r))
+			break;
+	}
+	if (MAXATTEMPTS == attempt) {
+		log_debug("Force the stairs of level %i\n", index);
+		world_force_stairs(l, ! first, ! last);
+	}
+	world_set_message(w, l, index);
+	l->creatures = &(w->creatures);
+	return(NULL);
+}
+
+/*
+ * Report a level that could not be generated. Only ever called from the
+ * main thread, which owns the terminal.
+ */
+static void
+world_gen_failed(int32_t index, const char *errstr)
+{
+	ui_cleanup();
+	errx(1, "can't generate level %i: %s", index, errstr);
+}
+
+/*
+ * Record of a level in the store, at an offset given by its index. Only
+ * what can't be generated again is kept: the tiles, whether the level was
+ * visited and what the player remembers of it, and what the coarse
+ * simulation needs. It comes first so it can be read on its own.
+ */
+struct levelrecord {
+	uint8_t		 present;
+	uint8_t		 visited;
+	uint8_t		 type;
+	struct levelmeta meta;
+	uint8_t		 tile[MAXROWS][MAXCOLS];
+	struct bitboard	 remembered;
+};
+
+static off_t
+world_record_offset(int32_t index)
+{
+	return((off_t)index * sizeof(struct levelrecord));
+}
+
+/*
+ * Tell if the level was already generated and written in the store.
+ * Reading past the end of the store gives nothing, which is fine.
+ */
+static bool
+world_stored(struct world *w, int32_t index)
+{
+	uint8_t present;
+
+	if (1 != pread(w->store, &present, 1, world_record_offset(index)))
+		return(false);
+	return(1 == present);
+}
+
+static void
+world_write(struct world *w, struct levelslot *slot)
+{
+	struct levelrecord	 rec;
+	struct level		*l = slot->level;
+
+	rec.present = 1;
+	rec.visited = l->visited;
+	rec.type = l->type;
+	rec.remembered = l->remembered;
+	rec.meta = slot->meta;
+	for (int y = 0; y < MAXROWS; y++) {
+		for (int x = 0; x < MAXCOLS; x++)
+			rec.tile[y][x] = l->tile[y][x].type;
+	}
+	if (sizeof(rec) != pwrite(w->store, &rec, sizeof(rec),
+	    world_record_offset(slot->index))) {
+		ui_cleanup();
+		err(1, "can't write level %i", slot->index);
+	}
+}
+
+static int
+world_read(struct world *w, int32_t index, struct levelslot *slot)
+{
+	struct levelrecord	 rec;
+	struct creatures	*t = &(w->creatures);
+	struct level		*l = slot->level;
+
+	if (sizeof(rec) != pread(w->store, &rec, sizeof(rec),
+	    world_record_offset(index)) || 1 != rec.present)
+		return(-1);
+	level_init(l);
+	l->type = rec.type;
+	l->visited = rec.visited;
+	l->remembered = rec.remembered;
+	for (int y = 0; y < MAXROWS; y++)
+		for (int x = 0; x < MAXCOLS; x++)
+			level_set_type(l, y, x, rec.tile[y][x]);
+	slot->meta = rec.meta;
+	for (uint32_t i = rec.meta.residents; 0 != i; i = t->sibling[i - 1])
+		level_set_creature(l, t->y[i - 1], t->x[i - 1],
+		    creature_handle(t, i - 1));
+	level_label(l);
+	world_set_message(w, l, index);
+	l->creatures = &(w->creatures);
+	return(0);
+}
+
+static struct levelslot *
+world_resident(struct world *w, int32_t index)
+{
+	for (int i = 0; i < WORLD_CACHESZ; i++)
+		if (index == w->cache[i].index)
+			return(&(w->cache[i]));
+	return(NULL);
+}
+
+/*
+ * Copy what the world keeps of the level number index, from the cache or
+ * from the store. A level never generated has nothing to tell.
+ */
+static void
+world_meta_get(struct world *w, int32_t index, struct levelmeta *meta)
+{
+	struct levelslot	*slot;
+	struct levelrecord	 rec;
+	size_t			 len = offsetof(struct levelrecord, tile);
+
+	if (NULL != (slot = world_resident(w, index))) {
+		*meta = slot->meta;
+		return;
+	}
+	if ((ssize_t)len != pread(w->store, &rec, len,
+	    world_record_offset(index)) || 1 != rec.present)
+		memset(&rec.meta, 0, sizeof(rec.meta));
+	*meta = rec.meta;
+}
+
+static void
+world_meta_put(struct world *w, int32_t index, const struct levelmeta *meta)
+{
+	struct levelslot *slot;
+
+	if (NULL != (slot = world_resident(w, index))) {
+		slot->meta = *meta;
+		return;
+	}
+	if (sizeof(*meta) != pwrite(w->store, meta, sizeof(*meta),
+	    world_record_offset(index) + offsetof(struct levelrecord, meta))) {
+		ui_cleanup();
+		err(1, "can't write level %i", index);
+	}
+}
+
+/*
+ * A level just generated has no creature yet and was never simulated.
+ */
+static void
+world_meta_init(struct levelslot *slot)
+{
+	slot->meta.residents = 0;
+	slot->meta.lasttick = 0;
+	slot->meta.walkable = slot->level->walkable;
+}
+
+static struct level *
+world_cached(struct world *w, int32_t index)
+{
+	struct levelslot *slot;
+
+	if (NULL == (slot = world_resident(w, index)))
+		return(NULL);
+	w->clock += 1;
+	slot->lastuse = w->clock;
+	return(slot->level);
+}
+
+/*
+ * Find room for a level in the cache, writing the least recently used one
+ * in the store if needed. Neither the current level nor the one just left
+ * are evicted, as the player is still moving between them.
+ */
+static struct levelslot *
+world_slot(struct world *w)
+{
+	struct levelslot *slot = NULL;
+
+	for (int i = 0; i < WORLD_CACHESZ; i++) {
+		if (-1 == w->cache[i].index)
+			return(&(w->cache[i]));
+		if (w->current == w->cache[i].index
+		    || w->previous == w->cache[i].index)
+			continue;
+		if (NULL == slot || w->cache[i].lastuse < slot->lastuse)
+			slot = &(w->cache[i]);
+	}
+	log_debug("Evict level %i\n", slot->index);
+	world_write(w, slot);
+	slot->index = -1;
+	return(slot);
+}
+
+/*
+ * Every allocation of the world comes from its arena and is only given
+ * back by world_free.
+ */
+static void *
+world_alloc(struct world *w, size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (NULL == (p = arena_calloc(&(w->arena), nmemb, size))) {
+		ui_cleanup();
+		err(1, "arena_calloc");
+	}
+	return(p);
+}
+
+/*
+ * Put a level generated in the background in the cache. The buffer of the
+ * slot is given back to the job in exchange.
+ */
+static void
+world_adopt(struct world *w, struct pregen *job)
+{
+	struct levelslot	*slot;
+	struct level		*l;
+
+	slot = world_slot(w);
+	l = slot->level;
+	slot->level = job->level;
+	slot->index = job->index;
+	w->clock += 1;
+	slot->lastuse = w->clock;
+	job->level = l;
+	world_meta_init(slot);
+}
+
+static void *
+world_pregen_main(void *arg)
+{
+	struct pregen *job = arg;
+
+	job->error = world_gen_level(job->world, job->level, job->index);
+	__atomic_store_n(&(job->ready), true, __ATOMIC_RELEASE);
+	return(NULL);
+}
+
+/*
+ * Wait for the background generation of a level to complete. If it was
+ * not needed the level is simply left in the buffer of the job.
+ */
+static void
+world_pregen_join(struct world *w, struct pregen *job, bool keep)
+{
+	if (! job->running)
+		return;
+	if (! __atomic_load_n(&(job->ready), __ATOMIC_ACQUIRE))
+		log_debug("Wait for the generation of level %i\n", job->index);
+	pthread_join(job->thread, NULL);
+	job->running = false;
+	if (keep && NULL != job->error)
+		world_gen_failed(job->index, job->error);
+	if (keep && NULL == world_resident(w, job->index))
+		world_adopt(w, job);
+}
+
+/*
+ * Give the level number index, from the cache, from the store or freshly
+ * generated.
+ */
+static struct level *
+world_fault(struct world *w, int32_t index)
+{
+	struct levelslot	*slot;
+	struct level		*l;
+	const char		*errstr;
+
+	if (NULL != (l = world_cached(w, index)))
+		return(l);
+	for (int i = 0; i < 2; i++) {
+		if (w->pregen[i].running && w->pregen[i].index == index) {
+			world_pregen_join(w, &(w->pregen[i]), true);
+			return(world_cached(w, index));
+		}
+	}
+	slot = world_slot(w);
+	if (NULL == slot->level)
+		slot->level = world_alloc(w, 1, sizeof(struct level));
+	if (-1 == world_read(w, index, slot)) {
+		log_debug("Generate level %i\n", index);
+		if (NULL != (errstr = world_gen_level(w, slot->level, index)))
+			world_gen_failed(index, errstr);
+		world_meta_init(slot);
+	} else {
+		log_debug("Load level %i\n", index);
+	}
+	slot->index = index;
+	w->clock += 1;
+	slot->lastuse = w->clock;
+	return(slot->level);
+}
+
+/*
+ * Start generating the levels around the current one while the player
+ * is busy. As each level only depends on its own stream, the result is the
+ * same as if they were generated when needed.
+ */
+static void
+world_prefetch(struct world *w)
+{
+	int32_t around[2];
+
+	around[0] = w->current - 1;
+	around[1] = w->current + 1;
+	for (int i = 0; i < 2; i++) {
+		struct pregen *job = &(w->pregen[i]);
+
+		if (job->running && job->index != around[i])
+			world_pregen_join(w, job, true);
+		if (job->running || around[i] < 0 || around[i] >= w->levelsz
+		    || NULL != world_resident(w, around[i])
+		    || world_stored(w, around[i]))
+			continue;
+		job->world = w;
+		job->index = around[i];
+		job->ready = false;
+		if (NULL == job->level)
+			job->level = world_alloc(w, 1, sizeof(struct level));
+		if (0 != pthread_create(&(job->thread), NULL,
+		    world_pregen_main, job))
+			continue;
+		job->running = true;
+	}
+}
+
+/*
+ * Only the first level is generated here, the others are generated when
+ * they are visited for the first time.
+ */
 void
-world_init(struct world *w)
+world_init(struct world *w, uint32_t seed, int32_t depth)
 {
+	struct rng	 r;
+	struct level	*first;
+	char		 path[] = "/tmp/roguelike.XXXXXXXXXX";
+
+	w->seed = seed;
 	w->current = 0;
-	w->levelsz = 5;
-	w->creaturesz = 3;
-	w->levels = calloc(w->levelsz, sizeof(struct level *));
-	/* The first level is the fixed entrance */
+	w->previous = 0;
+	w->levelsz = depth;
+	w->clock = 0;
+	arena_init(&(w->arena));
+	creatures_init(&(w->creatures), &(w->arena));
+	for (int i = 0; i < WORLD_CACHESZ; i++) {
+		w->cache[i].index = -1;
+		w->cache[i].lastuse = 0;
+		w->cache[i].level = NULL;
+	}
+	/* The store is unlinked at once so it goes away with the process */
+	if (-1 == (w->store = mkstemp(path))) {
+		ui_cleanup();
+		err(1, "mkstemp");
+	}
+	(void)unlink(path);
+	for (int i = 0; i < 2; i++) {
+		w->pregen[i].running = false;
+		w->pregen[i].level = NULL;
+	}
+	w->turn = 0;
+	w->player = CREATURE_NONE;
+	sched_init(&(w->sched), &(w->arena));
 	log_debug("Generate the first level\n");
-	w->levels[0] = calloc(1, sizeof(struct level));
-	do {
-		level_init(w->levels[0]);
-		cave_gen(w->levels[0]);
-		level_load(w->levels[0], "misc/entry");
-	} while (-1 == level_add_stairs(w->levels[0], false, true));
-	w->levels[0]->entrymessage = (char *)ENTRY_MSG;
-	/* Generate three random caves */
-	log_debug("Generate three random caves\n");
-	for (int32_t i = 1; i < w->levelsz - 1; i++) {
-		w->levels[i] = calloc(1, sizeof(struct level));
-		level_init(w->levels[i]);
-		cave_gen(w->levels[i]);
-		level_add_stairs(w->levels[i], true, true);
-	}
-	/* The final level is the fixed hall room of Goblin King */
-	log_debug("Generate the Goblin King's room\n");
-	w->levels[w->levelsz - 1] = calloc(1, sizeof(struct level));
-	level_init(w->levels[w->levelsz - 1]);
-	cave_gen(w->levels[w->levelsz - 1]);
-	w->levels[w->levelsz - 1]->entrymessage = (char *)END_MSG;
-	level_load(w->levels[w->levelsz - 1], "misc/hall");
-	level_add_stairs(w->levels[w->levelsz - 1], true, false);
-
+	first = world_fault(w, 0);
 	log_debug("--- creature (goblins) ---\n");
-	w->creatures = calloc(w->creaturesz, sizeof(struct creature *));
-	for (int32_t i = 0; i < w->creaturesz; i++) {
-		w->creatures[i] = calloc(1, sizeof(struct creature));
-		creature_init(w->creatures[i], R_GOBLIN);
-		creature_place_randomly(w->creatures[i], w->levels[0]);
+	rng_init_stream(&r, w->seed, RNG_POPULATE, 0);
+	for (int i = 0; i < WORLD_GOBLINS; i++) {
+		uint32_t c;
+
+		c = world_spawn(w, R_GOBLIN);
+		creature_place_randomly(&(w->creatures), c, first, &r);
+		world_settle(w, c, 0);
+		world_schedule(w, c, -1);
+	}
+	if (-1 == sched_at(&(w->sched), EV_TURN, 0, ORDER_TURN)) {
+		ui_cleanup();
+		errx(1, "can't schedule turn 0");
+	}
+	world_prefetch(w);
+}
+
+/*
+ * Add a creature already placed on the level number index to the list of
+ * this level. The list is kept sorted so it is walked in the order of the
+ * table.
+ */
+void
+world_settle(struct world *w, uint32_t c, int32_t index)
+{
+	struct creatures	*t = &(w->creatures);
+	struct levelmeta	 meta;
+	uint32_t		*link;
+
+	t->depth[CREATURE_INDEX(c)] = index;
+	world_meta_get(w, index, &meta);
+	link = &(meta.residents);
+	while (0 != *link && *link - 1 < CREATURE_INDEX(c))
+		link = &(t->sibling[*link - 1]);
+	t->sibling[CREATURE_INDEX(c)] = *link;
+	*link = CREATURE_INDEX(c) + 1;
+	world_meta_put(w, index, &meta);
+}
+
+/*
+ * Coarse simulation of a level away from the player: the energy gathered
+ * by its creatures since its last tick is spent at once, in a few random
+ * steps. Only the walkable cells of the level and the positions of its
+ * creatures are needed, so it does not have to be loaded.
+ */
+static void
+world_tick_far(struct world *w, int32_t index)
+{
+	struct creatures	*t = &(w->creatures);
+	struct levelslot	*slot;
+	struct levelmeta	 meta;
+	struct level		*l = NULL;
+	struct bitboard		 room;
+	int64_t			 elapsed, energy;
+
+	world_meta_get(w, index, &meta);
+	if (0 == meta.residents)
+		return;
+	if (NULL != (slot = world_resident(w, index)))
+		l = slot->level;
+	elapsed = w->turn - meta.lasttick;
+	meta.lasttick = w->turn;
+	world_meta_put(w, index, &meta);
+	room = meta.walkable;
+	for (uint32_t i = meta.residents; 0 != i; i = t->sibling[i - 1])
+		BITBOARD_UNSET(&room, t->y[i - 1], t->x[i - 1]);
+	for (uint32_t i = meta.residents; 0 != i; i = t->sibling[i - 1]) {
+		uint32_t c = i - 1;
+
+		energy = t->actionpoints[c] + t->speed[c] * elapsed;
+		t->actionpoints[c] = energy % CREATURE_ACTIONCOST;
+		energy /= CREATURE_ACTIONCOST;
+		creature_wander(t, creature_handle(t, c), l, &room,
+		    energy < COARSESTEPS ? energy : COARSESTEPS);
+	}
+}
+
+/*
+ * Number of turns a creature has to wait to gather enough energy to act.
+ */
+static uint64_t
+world_delay(struct creatures *t, uint32_t i)
+{
+	if (t->actionpoints[i] >= CREATURE_ACTIONCOST)
+		return(0);
+	return((CREATURE_ACTIONCOST - t->actionpoints[i] + t->speed[i] - 1)
+	    / t->speed[i]);
+}
+
+/*
+ * Schedule the next action of a creature whose energy was gathered up to
+ * the turn credited. It is only given the energy of the turns it waited
+ * when it acts.
+ */
+static void
+world_schedule(struct world *w, uint32_t c, int64_t credited)
+{
+	struct creatures	*t = &(w->creatures);
+	uint32_t		 i = CREATURE_INDEX(c);
+	int64_t			 time;
+
+	if (t->speed[i] <= 0)
+		return;
+	time = credited + world_delay(t, i);
+	if (time < (int64_t)w->turn)
+		time = w->turn;
+	if (-1 == sched_at(&(w->sched), EV_CREATURE(c), time,
+	    c == w->player ? ORDER_PLAYER : EV_CREATURE(c))) {
+		ui_cleanup();
+		errx(1, "can't schedule creature %u", i);
+	}
+}
+
+/*
+ * Spend the energy of an action of a creature, taken on the turn time,
+ * and schedule its next one.
+ */
+static void
+world_act(struct world *w, uint32_t c, uint64_t time)
+{
+	struct creatures	*t = &(w->creatures);
+	uint32_t		 i = CREATURE_INDEX(c);
+
+	sched_cancel(&(w->sched), EV_CREATURE(c));
+	t->actionpoints[i] += world_delay(t, i) * t->speed[i];
+	t->actionpoints[i] -= CREATURE_ACTIONCOST;
+	world_schedule(w, c, time);
+}
+
+/*
+ * Close the turn: one of the levels away from the player is simulated, in
+ * rotation, so what is simulated only depends on the number of turns and
+ * a given seed always gives the same result whatever the levels in memory.
+ */
+static void
+world_end_turn(struct world *w, uint64_t time)
+{
+	int32_t far;
+
+	far = time % w->levelsz;
+	if (far != w->current)
+		world_tick_far(w, far);
+	w->turn = time + 1;
+	if (-1 == sched_at(&(w->sched), EV_TURN, w->turn, ORDER_TURN)) {
+		ui_cleanup();
+		errx(1, "can't schedule turn %llu", (unsigned long long)w->turn);
+	}
+}
+
+/*
+ * The creatures of a level only act on their own while the player is on
+ * it, the scheduler forgets about them when the player leaves and they
+ * are simulated coarsely from then on.
+ */
+static void
+world_leave(struct world *w, int32_t index)
+{
+	struct creatures	*t = &(w->creatures);
+	struct levelmeta	 meta;
+
+	world_meta_get(w, index, &meta);
+	for (uint32_t i = meta.residents; 0 != i; i = t->sibling[i - 1])
+		sched_cancel(&(w->sched), i);
+	meta.lasttick = w->turn - 1;
+	world_meta_put(w, index, &meta);
+}
+
+static void
+world_enter(struct world *w, int32_t index)
+{
+	struct creatures	*t = &(w->creatures);
+	struct levelmeta	 meta;
+
+	world_tick_far(w, index);
+	world_meta_get(w, index, &meta);
+	for (uint32_t i = meta.residents; 0 != i; i = t->sibling[i - 1])
+		world_schedule(w, creature_handle(t, i - 1), w->turn);
+}
+
+/*
+ * Play every event due until the player can act. Creatures of the current
+ * level act in full while those of the other levels are simulated at the
+ * end of each turn.
+ */
+void
+world_run(struct world *w, struct distmaps *dm)
+{
+	struct creatures	*t = &(w->creatures);
+	struct level		*l;
+	uint64_t		 time;
+	uint32_t		 id, c;
+
+	l = world_current(w);
+	while (0 == sched_peek(&(w->sched), &id, &time)) {
+		if (EV_TURN == id) {
+			world_end_turn(w, time);
+			continue;
+		}
+		c = creature_handle(t, id - 1);
+		if (c == w->player)
+			return;
+		creature_do_something(t, c, l, dm);
+		world_act(w, c, time);
+	}
+}
+
+/*
+ * The player acted, give the hand back to the scheduler.
+ */
+void
+world_spend(struct world *w, uint32_t c)
+{
+	world_act(w, c, w->turn);
+}
+
+/*
+ * Tell the world which creature is controlled by the player, it acts
+ * first on each turn.
+ */
+void
+world_set_player(struct world *w, uint32_t c)
+{
+	w->player = c;
+	world_schedule(w, c, (int64_t)w->turn - 1);
+}
+
+/*
+ * Add a creature to the world, with its own stream derived from the seed
+ * of the world and its slot.
+ */
+uint32_t
+world_spawn(struct world *w, enum race race)
+{
+	uint32_t c;
+
+	if (CREATURE_NONE == (c = creature_spawn(&(w->creatures), race))) {
+		ui_cleanup();
+		errx(1, "too many creatures");
 	}
+	rng_stream_init(&(w->creatures.rng[CREATURE_INDEX(c)]), w->seed,
+	    RNG_CREATURE, CREATURE_INDEX(c));
+	return(c);
 }
 
 struct level *
 world_first(struct world *w)
 {
-	return w->levels[0];
+	return world_fault(w, 0);
 }
 
 struct level *
 world_next(struct world *w)
 {
+	struct level *l;
+
+	w->previous = w->current;
 	if (w->current + 1 < w->levelsz)
 		w->current += 1;
-	return world_current(w);
+	l = world_current(w);
+	if (w->previous != w->current) {
+		world_leave(w, w->previous);
+		world_enter(w, w->current);
+	}
+	world_prefetch(w);
+	return l;
 }
 
 struct level *
 world_prev(struct world *w)
 {
+	struct level *l;
+
+	w->previous = w->current;
 	if (w->current - 1 >= 0)
 		w->current -= 1;
-	return world_current(w);
+	l = world_current(w);
+	if (w->previous != w->current) {
+		world_leave(w, w->previous);
+		world_enter(w, w->current);
+	}
+	world_prefetch(w);
+	return l;
 }
 
 struct level *
 world_current(struct world *w)
 {
-	return w->levels[w->current];
+	return world_fault(w, w->current);
 }
 
 void
 world_free(struct world *w)
 {
-	for (int32_t i = 0; i < w->levelsz; i++) {
-		free(w->levels[i]);
-		w->levels[i] = NULL;
+	for (int i = 0; i < 2; i++)
+		world_pregen_join(w, &(w->pregen[i]), false);
+	for (int i = 0; i < WORLD_CACHESZ; i++) {
+		w->cache[i].level = NULL;
+		w->cache[i].index = -1;
 	}
-	free(w->levels);
-	w->levels = NULL;
+	for (int i = 0; i < 2; i++)
+		w->pregen[i].level = NULL;
+	(void)close(w->store);
+	w->store = -1;
+	arena_log_stats(&(w->arena), "world");
+	arena_release(&(w->arena));
+	creatures_init(&(w->creatures), NULL);
 	w->levelsz = 0;
 	w->current = -1;
 }
@@ -17,18 +17,84 @@
 #ifndef WORLD_H__
 #define WORLD_H__
 
-struct level;
-struct creature;
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+#include "arena.h"
+#include "creature.h"
+#include "level.h"
+#include "sched.h"
+
+struct distmaps;
+struct world;
+
+/*
+ * A level being generated by a background thread. It is handed over to the
+ * world when the thread is joined; the ready flag only tells whether that
+ * join would have to wait.
+ */
+struct pregen {
+	pthread_t	  thread;
+	struct world	 *world;
+	struct level	 *level;
+	int32_t		  index;
+	bool		  running;
+	bool		  ready;
+	const char	 *error;	/* Why the level failed, if it did */
+};
+
+#define WORLD_DEPTH	5	/* Default number of levels */
+#define WORLD_GOBLINS	3	/* Goblins on the first level */
+
+/*
+ * Only the most recently used levels stay in memory, the others are written
+ * in the store and read back when needed.
+ */
+#define WORLD_CACHESZ	4
+
+/*
+ * What the world keeps of a level even away from the player, for the
+ * coarse simulation: its creatures, the last turn it was simulated and
+ * its walkable cells. It follows the level, in its slot of the cache or in
+ * its record in the store.
+ */
+struct levelmeta {
+	uint32_t	  residents;	/* First creature + 1 */
+	uint64_t	  lasttick;
+	struct bitboard	  walkable;
+};
+
+struct levelslot {
+	int32_t		  index;
+	uint64_t	  lastuse;
+	struct level	 *level;
+	struct levelmeta  meta;
+};
 
 struct world {
+	uint32_t	  seed;
 	int32_t		  levelsz;
-	int32_t		  creaturesz;
 	int32_t	  	  current;
-	struct level	**levels;
-	struct creature **creatures;
+	int32_t		  previous;
+	uint64_t	  clock;
+	struct levelslot  cache[WORLD_CACHESZ];
+	int		  store;
+	struct creatures  creatures;
+	uint64_t	  turn;
+	struct sched	  sched;
+	uint32_t	  player;
+	struct pregen	  pregen[2];
+	struct arena	  arena;
 };
 
-void world_init(struct world *);
+void world_init(struct world *, uint32_t, int32_t);
+uint32_t world_spawn(struct world *, enum race);
+void world_settle(struct world *, uint32_t, int32_t);
+void world_set_player(struct world *, uint32_t);
+void world_run(struct world *, struct distmaps *);
+void world_spend(struct world *, uint32_t);
 void world_add(struct world *, struct level *);
 void world_free(struct world *);
 struct level *world_first(struct world *);